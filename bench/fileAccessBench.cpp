@@ -0,0 +1,105 @@
+/*
+ * Copyright 2024 NearEDGE, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <benchmark/benchmark.h>
+
+#include <fstream>
+#include <string>
+#include <filesystem>
+
+#include <unistd.h>
+
+#include "helpers/fileAccess.h"
+
+//
+// helpers::fileAccess::readFile against the former stream based readAll, on the kind of files the metadata
+// probes read (/proc pseudo files, small /etc files) and on a larger regular file.
+//
+
+namespace {
+  // The former implementation, line by line and ended by an exception
+  const std::string streamReadAll(const std::filesystem::path& file) {
+    std::string         retval;
+
+    if (std::filesystem::exists(file) == true) {
+      std::ifstream     filehandle(file.string(), std::ios::binary | std::ios::in);
+      try {
+        filehandle.exceptions(std::ios::failbit | std::ios::badbit);
+        while (true) {
+          std::string   readval;
+          std::getline(filehandle, readval);
+          retval += readval;
+        }
+      } catch (std::exception& exc) {
+        if (filehandle.eof() == false) {
+          throw;
+        }
+      }
+    }
+    return retval;
+  }
+
+  // Removed when the run ends
+  struct scratchFile {
+    const std::filesystem::path         path = std::filesystem::temp_directory_path() / ("latchy_bench." + std::to_string(getpid()));
+    ~scratchFile() { std::error_code ec; std::filesystem::remove(path, ec); }
+  };
+
+  const std::filesystem::path& largeFile() {
+    // 64 KiB of 64 character lines
+    static const scratchFile            file;
+    static const bool                   created = [&]() {
+      std::ofstream                     out(file.path);
+      for (int i = 0; i < 1024; ++i) {
+        out << std::string(63, 'a' + (i % 26)) << '\n';
+      }
+      return true;
+    }();
+    (void) created;
+    return file.path;
+  }
+
+  const std::filesystem::path           files[] = { "/proc/self/cgroup", "/proc/self/status", "/etc/hostname", largeFile() };
+
+  void streamRead(benchmark::State& state) {
+    const std::filesystem::path&        file = files[state.range(0)];
+    for (auto _ : state) {
+      benchmark::DoNotOptimize(streamReadAll(file));
+    }
+    state.SetLabel(file.string());
+  }
+
+  void descriptorRead(benchmark::State& state) {
+    const std::filesystem::path&        file = files[state.range(0)];
+    std::string                         content;
+    for (auto _ : state) {
+      benchmark::DoNotOptimize(helpers::fileAccess::readFile(file, content));
+    }
+    state.SetLabel(file.string());
+  }
+
+  void descriptorReadPreserved(benchmark::State& state) {
+    const std::filesystem::path&        file = files[state.range(0)];
+    std::string                         content;
+    for (auto _ : state) {
+      benchmark::DoNotOptimize(helpers::fileAccess::readFile(file, content, true));
+    }
+    state.SetLabel(file.string());
+  }
+}
+
+BENCHMARK(streamRead)->DenseRange(0, 3)->Unit(benchmark::kMicrosecond);
+BENCHMARK(descriptorRead)->DenseRange(0, 3)->Unit(benchmark::kMicrosecond);
+BENCHMARK(descriptorReadPreserved)->DenseRange(0, 3)->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,168 @@
+/*
+ * Copyright 2024 NearEDGE, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <array>
+#include <map>
+#include <cstdlib>
+#include <filesystem>
+
+#include <jansson.h>
+
+#include "joseCommon.h"
+#include "joseClevisDecrypt.h"
+#include "helpers/fileAccess.h"
+
+//
+// The JWE and key handling steps of an unseal, as done by assetFileClevis. The Tang server is played locally
+// with its exchange key so that nothing goes over the network.
+//
+// The JWE come from bench/makeFixtures.sh, in the directory named by LATCHY_BENCH_FIXTURES (defaults to the
+// fixtures directory of the build). Without them, the JWE benchmarks are skipped.
+//
+
+#ifndef LATCHY_BENCH_FIXTURES
+#define LATCHY_BENCH_FIXTURES "fixtures"
+#endif
+
+namespace {
+  const std::array<const char*, 3>      curves = { "P-256", "P-384", "P-521" };
+
+  std::filesystem::path fixtures() {
+    const char*                         fromEnv = std::getenv("LATCHY_BENCH_FIXTURES");
+    return (fromEnv != nullptr) ? std::filesystem::path(fromEnv) : std::filesystem::path(LATCHY_BENCH_FIXTURES);
+  }
+
+  // Compact JWE sealing size bytes, empty when the fixture is missing
+  const std::string& compactJWE(std::int64_t size) {
+    static std::map<std::int64_t, std::string>    cache;
+    auto                                found = cache.find(size);
+    if (found == cache.end()) {
+      std::string                       content;
+      helpers::fileAccess::readFile(fixtures() / ("secret-" + std::to_string(size) + ".jwe"), content, true);
+      while ( (content.empty() == false) and (content.back() == '\n') ) {
+        content.pop_back();
+      }
+      found = cache.emplace(size, std::move(content)).first;
+    }
+    return found->second;
+  }
+
+  // Everything up to recoverPayload, as assetFileClevis::recoverPrivateKey does it
+  struct unsealed {
+    json_t*                             jwe = nullptr;
+    json_t*                             unwrappingJWK = nullptr;
+
+    unsealed(const std::string& compact) {
+      json_t*                           serverKey = json_load_file((fixtures() / "exc.jwk").c_str(), 0, nullptr);
+      jwe = joseLibWrapper::decrypt::decomposeCompactJWE(compact);
+      joseLibWrapper::decrypt::checkJWE   checker(jwe);
+
+      json_t*                           ephemeral = joseLibWrapper::generateKey(checker.getEpkCurve());
+      json_t*                           exchange = joseLibWrapper::keyExchange(checker.getEpk(), ephemeral);
+      json_t*                           exchange2 = joseLibWrapper::keyExchange(ephemeral, checker.getActiveKey());
+      json_t*                           recovering = joseLibWrapper::keyExchange(serverKey, exchange);    // What Tang answers
+      joseLibWrapper::removePrivate(recovering);
+      unwrappingJWK = joseLibWrapper::keyExchange(recovering, exchange2, true);
+
+      json_decref(recovering);
+      json_decref(exchange2);
+      json_decref(exchange);
+      json_decref(ephemeral);
+      json_decref(serverKey);
+    }
+    ~unsealed() {
+      json_decref(unwrappingJWK);
+      json_decref(jwe);
+    }
+  };
+
+  void decomposeCompactJWE(benchmark::State& state) {
+    const std::string&                  compact = compactJWE(32);
+    if (compact.empty() == true) {
+      state.SkipWithError("No JWE fixture, run bench/makeFixtures.sh");
+      return;
+    }
+    for (auto _ : state) {
+      json_t*                           jwe = joseLibWrapper::decrypt::decomposeCompactJWE(compact);
+      benchmark::DoNotOptimize(jwe);
+      json_decref(jwe);
+    }
+  }
+
+  void checkJWE(benchmark::State& state) {
+    const std::string&                  compact = compactJWE(32);
+    if (compact.empty() == true) {
+      state.SkipWithError("No JWE fixture, run bench/makeFixtures.sh");
+      return;
+    }
+    json_t*                             jwe = joseLibWrapper::decrypt::decomposeCompactJWE(compact);
+    for (auto _ : state) {
+      joseLibWrapper::decrypt::checkJWE   checker(jwe);
+      benchmark::DoNotOptimize(checker.getActiveKey());
+    }
+    json_decref(jwe);
+  }
+
+  void generateKey(benchmark::State& state) {
+    json_t*                             curve = json_string(curves[state.range(0)]);
+    for (auto _ : state) {
+      json_t*                           key = joseLibWrapper::generateKey(curve);
+      benchmark::DoNotOptimize(key);
+      json_decref(key);
+    }
+    json_decref(curve);
+    state.SetLabel(curves[state.range(0)]);
+  }
+
+  void keyExchange(benchmark::State& state) {
+    json_t*                             curve = json_string(curves[state.range(0)]);
+    json_t*                             local = joseLibWrapper::generateKey(curve);
+    json_t*                             remote = joseLibWrapper::generateKey(curve);
+    joseLibWrapper::removePrivate(remote);
+    for (auto _ : state) {
+      json_t*                           exchanged = joseLibWrapper::keyExchange(local, remote);
+      benchmark::DoNotOptimize(exchanged);
+      json_decref(exchanged);
+    }
+    json_decref(remote);
+    json_decref(local);
+    json_decref(curve);
+    state.SetLabel(curves[state.range(0)]);
+  }
+
+  void recoverPayload(benchmark::State& state) {
+    const std::string&                  compact = compactJWE(state.range(0));
+    if (compact.empty() == true) {
+      state.SkipWithError("No JWE fixture, run bench/makeFixtures.sh");
+      return;
+    }
+    unsealed                            ready(compact);
+    for (auto _ : state) {
+      std::string                       secret = joseLibWrapper::decrypt::recoverPayload(ready.unwrappingJWK, ready.jwe);
+      benchmark::DoNotOptimize(secret);
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+  }
+}
+
+BENCHMARK(decomposeCompactJWE)->Unit(benchmark::kMicrosecond);
+BENCHMARK(checkJWE)->Unit(benchmark::kMicrosecond);
+BENCHMARK(generateKey)->DenseRange(0, 2)->Unit(benchmark::kMicrosecond);
+BENCHMARK(keyExchange)->DenseRange(0, 2)->Unit(benchmark::kMicrosecond);
+// Payload sizes as generated by bench/makeFixtures.sh
+BENCHMARK(recoverPayload)->Arg(32)->Arg(1024)->Arg(64 << 10)->Arg(1 << 20)->Arg(16 << 20)->Arg(64 << 20)->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,79 @@
+/*
+ * Copyright 2024 NearEDGE, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <benchmark/benchmark.h>
+
+#include <vector>
+#include <algorithm>
+#include <cstring>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "helpers/forkExec.h"
+
+//
+// Spawn latency of os::launch against a plain fork()+exec, for a parent of growing resident size.
+// The argument is the amount of memory (MiB) the parent touched before spawning.
+//
+
+namespace {
+  std::vector<char>         ballast;
+
+  void growParent(std::size_t megaBytes) {
+    if (ballast.size() != megaBytes*1024*1024) {
+      ballast.assign(megaBytes*1024*1024, 0);
+      memset(ballast.data(), 1, ballast.size());   // Really resident, not only reserved
+    }
+  }
+
+  // Waits for the child, keeping its own peak RSS. RUSAGE_SELF and RUSAGE_CHILDREN are process lifetime high
+  // water marks, they would report the largest case for every later one
+  void reap(int pid, long& childPeak) {
+    int                     status;
+    struct rusage           usage;
+    if (wait4(pid, &status, 0, &usage) == pid) {
+      childPeak = std::max(childPeak, usage.ru_maxrss);
+    }
+  }
+
+  void launchSpawn(benchmark::State& state) {
+    growParent(state.range(0));
+    long                    childPeak = 0;
+    for (auto _ : state) {
+      int                   pid = os::launch::launch("/bin/true", {});
+      reap(pid, childPeak);
+    }
+    state.counters["childPeakRssKiB"] = benchmark::Counter(childPeak);
+  }
+
+  void forkSpawn(benchmark::State& state) {
+    growParent(state.range(0));
+    long                    childPeak = 0;
+    for (auto _ : state) {
+      int                   pid = fork();
+      if (pid == 0) {
+        execl("/bin/true", "/bin/true", (char*) nullptr);
+        _exit(72);
+      }
+      reap(pid, childPeak);
+    }
+    state.counters["childPeakRssKiB"] = benchmark::Counter(childPeak);
+  }
+}
+
+BENCHMARK(launchSpawn)->RangeMultiplier(8)->Range(1, 512)->Unit(benchmark::kMicrosecond)->UseRealTime();
+BENCHMARK(forkSpawn)->RangeMultiplier(8)->Range(1, 512)->Unit(benchmark::kMicrosecond)->UseRealTime();
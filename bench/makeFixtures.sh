@@ -0,0 +1,22 @@
+#!/bin/sh
+#
+# Tang keys and clevis JWE for latchy_bench (see joseBench.cpp), without a Tang server: the advertisement is
+# built locally and handed to clevis. Requires jose and clevis.
+#
+#   bench/makeFixtures.sh [DIRECTORY]      (defaults to build/bench/fixtures)
+#
+set -e
+
+out="${1:-build/bench/fixtures}"
+mkdir -p "$out"
+cd "$out"
+
+# The same keys and advertisement tangd would have
+jose jwk gen -i '{"alg":"ES512"}' -o sig.jwk
+jose jwk gen -i '{"alg":"ECMR"}' -o exc.jwk
+jose jwk pub -s -i sig.jwk -i exc.jwk | jose jws sig -I- -s '{"protected":{"cty":"jwk-set+json"}}' -k sig.jwk -o adv.jws
+
+# Payload sizes used by the recoverPayload benchmark
+for size in 32 1024 65536 1048576 16777216 67108864; do
+  head -c "$size" /dev/urandom | clevis encrypt tang '{"url":"http://tang.invalid","adv":"adv.jws"}' > "secret-$size.jwe"
+done
@@ -0,0 +1,142 @@
+/*
+ * Copyright 2024 NearEDGE, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <vector>
+#include <deque>
+
+#include <botan/base64.h>
+
+#include "configuration.h"
+#include "helpers/b64.h"
+#include "helpers/stringSplit.h"
+#include "metaInfo/metaInfo.h"
+#include "metaInfo/machineInfo.h"
+#include "metaInfo/processInfo.h"
+#include "metaInfo/containerInfo.h"
+
+//
+// Helpers on the configuration and unsealing paths: base64, splitting, configuration parsing and the process
+// metadata.
+//
+
+namespace {
+  std::string randomBytes(std::size_t size) {
+    std::string                         retval(size, '\0');
+    std::uint32_t                       state = 0x9e3779b9;
+    for (auto& c : retval) {
+      state = state * 1664525 + 1013904223;
+      c = (char) (state >> 24);
+    }
+    return retval;
+  }
+
+  // URL friendly base64, as found in a compact JWE
+  std::string urlEncoded(std::size_t size) {
+    const std::string                   raw = randomBytes(size);
+    std::string                         retval = Botan::base64_encode(reinterpret_cast<const std::uint8_t*>(raw.data()), raw.size());
+    for (auto& c : retval) {
+      c = (c == '+') ? '-' : ((c == '/') ? '_' : c);
+    }
+    return retval;
+  }
+
+  // A configuration declaring count secrets
+  std::string secretList(std::size_t count) {
+    std::string                         retval(R"({"secrets":[)");
+    for (std::size_t i = 0; i < count; ++i) {
+      retval += ((i == 0) ? "" : ",");
+      retval += R"({"iMethod":"IFILE","in":"/run/secrets/sealed/)" + std::to_string(i) + R"(.jwe","lockingMethod":"CLEVIS","eMethod":"PIPE","out":"/run/secrets/)" + std::to_string(i) + R"(","outCount":2,"ttl":30})";
+    }
+    return retval + "]}";
+  }
+
+  void extractB64(benchmark::State& state) {
+    const std::string                   encoded = urlEncoded(state.range(0));
+    for (auto _ : state) {
+      benchmark::DoNotOptimize(misc::extractB64(encoded, true));
+    }
+    state.SetBytesProcessed(state.iterations() * encoded.size());
+  }
+
+  void fromURL(benchmark::State& state) {
+    const std::string                   encoded = urlEncoded(state.range(0));
+    for (auto _ : state) {
+      std::string                       work(encoded);
+      benchmark::DoNotOptimize(misc::fromURL(work));
+    }
+    state.SetBytesProcessed(state.iterations() * encoded.size());
+  }
+
+  void split(benchmark::State& state) {
+    // A compact JWE has 5 parts, a /proc/self/status line 2. Use many small fields to make the splitting show
+    std::string                         line;
+    for (std::int64_t i = 0; i < state.range(0); ++i) {
+      line += ((i == 0) ? "" : ".") + urlEncoded(24);
+    }
+    for (auto _ : state) {
+      benchmark::DoNotOptimize(misc::split(line, '.'));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+  }
+
+  void parseStringToMsg(benchmark::State& state) {
+    const std::string                   cfg = secretList(state.range(0));
+    for (auto _ : state) {
+      std::string                       work(cfg);
+      benchmark::DoNotOptimize(configuration::parseStringToMsg(work));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetBytesProcessed(state.iterations() * cfg.size());
+  }
+
+  void prettyPrintJson(benchmark::State& state) {
+    const std::string                   cfg = secretList(state.range(0));
+    for (auto _ : state) {
+      benchmark::DoNotOptimize(configuration::prettyPrintJson(cfg));
+    }
+    state.SetBytesProcessed(state.iterations() * cfg.size());
+  }
+
+  // What each asset pays, the process snapshot being shared
+  void compositionConstruction(benchmark::State& state) {
+    for (auto _ : state) {
+      meta::composition                 metaData;
+      benchmark::DoNotOptimize(metaData.getComposedHash());
+    }
+  }
+
+  // What the snapshot costs, once per process, source by source
+  template <typename T>
+  void metaSource(benchmark::State& state) {
+    for (auto _ : state) {
+      T                                 source;
+      benchmark::DoNotOptimize(source.rawData());
+    }
+  }
+}
+
+BENCHMARK(extractB64)->RangeMultiplier(16)->Range(32, 1 << 20)->Unit(benchmark::kMicrosecond);
+BENCHMARK(fromURL)->RangeMultiplier(16)->Range(32, 1 << 20)->Unit(benchmark::kMicrosecond);
+BENCHMARK(split)->RangeMultiplier(4)->Range(4, 1024)->Unit(benchmark::kMicrosecond);
+BENCHMARK(parseStringToMsg)->RangeMultiplier(10)->Range(1, 10000)->Unit(benchmark::kMicrosecond);
+BENCHMARK(prettyPrintJson)->RangeMultiplier(10)->Range(1, 10000)->Unit(benchmark::kMicrosecond);
+BENCHMARK(compositionConstruction)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(metaSource, meta::machine::info)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(metaSource, meta::machine::hostname)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(metaSource, meta::process::info)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(metaSource, meta::container::info)->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,221 @@
+/*
+ * Copyright 2024 NearEDGE, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "agent.h"
+#include "helpers/log.h"
+#include "helpers/unixSocket.h"
+
+#include <cstring>
+#include <csignal>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <errno.h>
+
+namespace agent {
+
+  std::atomic<bool>     signalled = false;
+
+  void signalHandler(int) {
+    signalled = true;
+  }
+
+  server::server(const std::string& path, bool c): socketPath(path), compatibleMode(c) {
+    curlWrapper::globalInit();    // Once for the whole life of the agent, so that the connection cache is shared
+    metaData.printInfo();
+  }
+
+  server::~server() {
+    terminate = true;
+    helpers::unixSocket::closeListener(listenDescriptor, socketPath);
+
+    // Let the sessions complete. The asset list itself is stopped by the base class
+    for (auto& session : sessions) {
+      session.wait();
+    }
+    sessions.clear();
+  }
+
+  void server::run() {
+    struct sigaction      action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = signalHandler;
+    sigaction(SIGTERM, &action, nullptr);
+    sigaction(SIGINT, &action, nullptr);
+    signal(SIGPIPE, SIG_IGN);     // A client going away is reported by write()
+
+    listenDescriptor = helpers::unixSocket::listenOn(socketPath);
+    USERMSG() << "Agent is listening on " << socketPath << std::endl;
+
+    while ( (terminate == false) and (signalled == false) ) {
+      int                 descriptor = helpers::unixSocket::acceptPeer(listenDescriptor, 250ms);
+
+      reap();
+
+      if (descriptor < 0) {
+        // Timeout, or an interrupt. Either way we check whether we must stop
+        continue;
+      }
+
+      if (helpers::unixSocket::isAuthorized(descriptor) == false) {
+        reply(descriptor, "ERROR - Unauthorized");
+        close(descriptor);
+        continue;
+      }
+
+      if (sessions.size() >= maxSessions) {
+        reply(descriptor, "ERROR - Busy, try again later");
+        close(descriptor);
+        continue;
+      }
+
+      sessions.push_back(std::async(std::launch::async, [this, descriptor]() { serveSession(descriptor); }));
+    }
+
+    INFO() << "Agent is stopping" << std::endl;
+    helpers::unixSocket::closeListener(listenDescriptor, socketPath);
+  }
+
+  void server::serveSession(int descriptor) {
+    std::string           request;
+    try {
+      struct timeval      timeout = { (time_t) receiveTimeout.count(), 0 };
+      setsockopt(descriptor, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+      const auto          deadline = std::chrono::steady_clock::now() + receiveTimeout;
+
+      // First, the declaration line
+      while ( (request.find('\n') == std::string::npos) and (readMore(descriptor, request, deadline) == true) ) {}
+      std::size_t         endOfLine = request.find('\n');
+
+      secretCfg_t         cfg = configuration::parseStringToDeclaration(request.substr(0, endOfLine));
+      assetSource_p       source = nullptr;
+      if (cfg.replace() == true) {
+        // The agent serves other clients, it can not become one's workload
+        throw badRequest("replace is not available through the agent");
+      }
+
+      if ( (cfg.in().empty() == true) and ( (cfg.imethod() == model::latchy::secretIngestionMethods::STDIN) or (cfg.imethod() == model::latchy::secretIngestionMethods::UNKNOWNINGESTION) ) ) {
+        // The JWE is the rest of the request
+        while (readMore(descriptor, request, deadline) == true) {}
+
+        std::string       jwe = (endOfLine == std::string::npos) ? "" : request.substr(endOfLine + 1);
+        while ( (jwe.empty() == false) and (jwe.back() == '\n') ) {
+          jwe.pop_back();
+        }
+        if (jwe.empty() == true) {
+          throw badRequest("Missing JWE after the declaration");
+        }
+
+        source = std::make_shared<assetserver::assetFileClevis>(assetserver::inMemory{jwe}, metaData, true, compatibleMode);
+        jwe.assign(jwe.size(), (char) 0);
+        source->timing()->label("agent request");
+      } else {
+        source = createSource(cfg, true, compatibleMode);
+      }
+      request.assign(request.size(), (char) 0);
+
+      if (cfg.emethod() == model::latchy::secretEgressMethods::STDOUT) {
+        // The plaintext goes back on the connection. We only say OK once we actually have it
+        while ( (terminate == false) and (source->waitReady(250ms) == false) ) {}
+        if (terminate == true) {
+          throw badRequest("Agent is stopping");
+        }
+
+        reply(descriptor, "OK");
+        assetserver::assetProviderDescriptor    provider(source, descriptor);
+        provider.start();
+        provider.get();
+      } else {
+        asset_p           provider = createProvider(cfg, source);
+        provider->start();
+        {
+          std::scoped_lock  lock(assetsMutex);
+          assets.insert(std::move(provider));
+        }
+        reply(descriptor, "OK");
+      }
+    } catch (std::exception& exc) {
+      request.assign(request.size(), (char) 0);
+      USERMSG() << "Failed to serve a request - " << exc.what() << std::endl;
+      reply(descriptor, std::string("ERROR - ") + exc.what());
+    }
+
+    close(descriptor);
+  }
+
+  void server::reap() {
+    // Assets are done once their provider completes. Exceptions are reported, not propagated, since other
+    // clients are still being served.
+    {
+      std::scoped_lock    lock(assetsMutex);
+      for (assetList::iterator asset = assets.begin(); asset != assets.end();) {
+        if ( (*asset != nullptr) and ((*asset)->wait(0s) == std::future_status::ready) ) {
+          try {
+            (*asset)->get();
+          } catch (std::exception& exc) {
+            USERMSG() << "Asset completed with an error - " << exc.what() << std::endl;
+          }
+          asset = assets.erase(asset);
+        } else {
+          ++asset;
+        }
+      }
+    }
+
+    sessions.remove_if([](std::future<void>& session) { return session.wait_for(0s) == std::future_status::ready; });
+  }
+
+  bool server::readMore(int descriptor, std::string& data, std::chrono::steady_clock::time_point deadline) const {
+    if (std::chrono::steady_clock::now() > deadline) {
+      throw badRequest("Timeout");
+    }
+
+    char                  buffer[4096];
+    ssize_t               retval;
+    do {
+      retval = read(descriptor, buffer, sizeof(buffer));
+    } while ( (retval < 0) and (errno == EINTR) );
+
+    if (retval < 0) {
+      throw badRequest(((errno == EAGAIN) or (errno == EWOULDBLOCK)) ? "Timeout" : strerror(errno));
+    }
+
+    data.append(buffer, retval);
+    memset(buffer, 0, sizeof(buffer));
+    if (data.size() > maxRequestSize) {
+      throw badRequest("Too large");
+    }
+
+    return retval != 0;
+  }
+
+  void server::reply(int descriptor, const std::string& status) const {
+    std::string           line(status + "\n");
+    std::size_t           writtenSoFar = 0;
+    while (writtenSoFar < line.size()) {
+      ssize_t             retval = write(descriptor, line.data() + writtenSoFar, line.size() - writtenSoFar);
+      if (retval < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        DEBUG() << "Failed to reply to the client - " << strerror(errno) << std::endl;
+        return;
+      }
+      writtenSoFar += retval;
+    }
+  }
+
+} // namespace agent
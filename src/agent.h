@@ -0,0 +1,78 @@
+/*
+ * Copyright 2024 NearEDGE, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <string>
+#include <list>
+#include <mutex>
+#include <atomic>
+#include <future>
+#include <stdexcept>
+
+#include "assets.h"
+
+namespace agent {
+  using namespace std::chrono_literals;
+
+  /// Long running latchy agent
+  ///
+  /// Instead of running one latchy process per secret, a single agent stays resident and serves unlock
+  /// requests received over a Unix domain socket. All requests share the same asset pipeline, which
+  /// means the same metadata snapshot and the same libcurl connection cache.
+  ///
+  /// The protocol is one request per connection:
+  ///   - The client sends a secretDeclaration, as a single line of JSON.
+  ///   - When iMethod is STDIN, the JWE follows that line and the client shuts down its writing side.
+  ///   - The agent answers with a status line, either "OK" or "ERROR - <reason>".
+  ///   - When eMethod is STDOUT, the plaintext follows the "OK" status line. The agent then closes the connection.
+  ///
+  /// Peers are authenticated using SO_PEERCRED. Only root and the user running the agent are served. At most
+  /// maxSessions requests are served at once, and a request must be received within receiveTimeout.
+  class server: public assets::list {
+  public:
+    server(const std::string& path, bool compatibleMode = false);
+    virtual ~server();
+
+    void                        run();                    // Serve requests until stop() is called or SIGTERM / SIGINT is received
+    void                        stop() { terminate = true; };
+
+  protected:
+    std::string                 socketPath;
+    bool                        compatibleMode = false;
+    int                         listenDescriptor = -1;
+    std::atomic<bool>           terminate = false;
+
+    std::mutex                  assetsMutex;              // The inherited asset list is shared by all the sessions
+    std::list<std::future<void>> sessions;                // One per connected client, until it is served
+
+    static constexpr std::size_t maxRequestSize = 1024*1024;
+    static constexpr std::size_t maxSessions = 64;          // Beyond, new connections are turned down until some complete
+    std::chrono::seconds        receiveTimeout = 10s;       // Per read, and for the whole request (a slow client can not hold a session)
+
+    void                        serveSession(int descriptor);
+    void                        reap();                   // Drop completed assets and sessions
+
+    bool                        readMore(int descriptor, std::string& data, std::chrono::steady_clock::time_point deadline) const;   // Append what is available. False on end of file
+    void                        reply(int descriptor, const std::string& status) const;
+
+  public:
+    class badRequest: public std::runtime_error {
+    public:
+      badRequest(const std::string& msg = ""): runtime_error("Invalid request" + ((msg.empty() == false) ? (" - " + msg) : "")) { };
+    };
+  };
+
+} // namespace agent
@@ -18,6 +18,9 @@
 #include "assets.h"
 #include "helpers/forkExec.h"
 #include "helpers/log.h"
+#include "helpers/metrics.h"
+#include "helpers/probes.h"
+#include "helpers/unixSocket.h"
 
 #include <memory>
 #include <thread>
@@ -33,11 +36,14 @@
 #include <unistd.h>
 #include <errno.h>
 #include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <poll.h>
 
 namespace assetserver {
   using namespace std::chrono_literals;
 
-  assetProvider::assetProvider(std::shared_ptr<assetSource<std::string>> p, const std::string& f, std::size_t c, bool fifo): assetProviderBase<std::string>(p), fileName(f), allocatedReadEvent(c), useFifo(fifo) {
+  assetProvider::assetProvider(std::shared_ptr<assetSource<std::string>> p, const std::string& f, std::size_t c, bool fifo, std::chrono::seconds t): assetProviderBase<std::string>(p), fileName(f), allocatedReadEvent(c), useFifo(fifo), ttl(t) {
     enableNonBindingMonitoring = true;
     stopDelay = 10s;
   }
@@ -53,6 +59,7 @@ namespace assetserver {
   void assetProvider::stop() {
     if (enableNonBindingMonitoring == true) {
       USERMSG() << "Monitor access to " << fileName << " for " << stopDelay.count() << "s" << std::endl;
+      metrics::span     lingering(source->timing(), metrics::stage::linger);
       std::this_thread::sleep_for(stopDelay);
     }
     terminate = true;
@@ -69,6 +76,7 @@ namespace assetserver {
     if ( (retval == 0 ) or (errno == EEXIST) ) {
       providerTask = std::async([&]() {
         // This runs in its own thread
+        logger::context   asset(fileName);
         INFO() << "Starting provider thread for " << fileName << std::endl;
         try {
           // The FIFO is ready to be opened by the client
@@ -79,18 +87,46 @@ namespace assetserver {
             while ( (terminate == false) and (monitorReady == false) ) {}    // We want to wait until the monitor thread is ready
           }
 
-          prepareFifo();
-          postFifoPreparation();
-          clientOpened = true;
+          // Serve allocatedReadEvent successive readers (or until the TTL runs out). The plaintext is kept
+          // in locked memory between them; the source is destroyed as soon as it was copied there.
+          while ( (terminate == false) and (allocatedReadEvent != 0) and (isExpired() == false) ) {
+            metrics::span     waiting(source->timing(), metrics::stage::waitReader);
+            prepareFifo();
+            waiting.close();
+            if (descriptor <= 0) {
+              break;    // Terminated or expired while waiting for a reader
+            }
+            postFifoPreparation();
+            clientOpened = true;
 
-          INFO() << "Named pipe is open and ready, we deliver to " << fileName << std::endl;
+            pinBuffer();
+            INFO() << "Named pipe is open and ready, we deliver to " << fileName << std::endl;
+            metrics::span     delivering(source->timing(), metrics::stage::delivery);
+            // The pages are only spliced into the pipe when another reader follows, since we then wait for
+            // this one to go away. The last delivery is copied, the buffer being scrubbed right after
+            deliverDataToFifo(allocatedReadEvent > 1);
+            delivering.close();
+            --allocatedReadEvent;
 
-          deliverDataToFifo();
-          source->destroy();
+            if (allocatedReadEvent != 0) {
+              // Do not hand a second copy to the same reader, wait until it goes away
+              if (waitForReaderClose() == true) {
+                spliced = false;
+              }
+            }
+            close(descriptor);
+            descriptor = 0;
+          }
 
           // Normal ending
-          close(descriptor);
+          unpinBuffer();
+          source->destroy();
         } catch(std::exception &exc) {
+          if (descriptor > 0) {
+            close(descriptor);
+            descriptor = 0;
+          }
+          unpinBuffer();
           source->destroy();
           throw;
         }
@@ -108,6 +144,7 @@ namespace assetserver {
     // We use a task / thread
     providerTask = std::async([&]() {
       // This runs in its own thread
+      logger::context     asset(fileName);
       try {
         // Create and write the target regular file
         createRegularFile();
@@ -122,8 +159,10 @@ namespace assetserver {
         //ready = true;
 
         // Monitor the file access by the end-application / client
+        metrics::span     consuming(source->timing(), metrics::stage::waitReader);
         monitorTask = std::async([&]() { monitorFileConsumption(true); });
         monitorTask.wait();
+        consuming.close();
 
         // Normal ending
         USERMSG() << "Clear-text secret \"" << fileName.c_str() << "\" was entirely consumed, destroying it" << std::endl;
@@ -140,11 +179,12 @@ namespace assetserver {
 
   void assetProvider::prepareFifo() {
     // First step is to open the fifo. This waits until the other end opens it too (for reading)
-    while ( (terminate == false) and (descriptor <= 0) ) {
+    while ( (terminate == false) and (descriptor <= 0) and (isExpired() == false) ) {
        descriptor = open(fileName.c_str(), O_CLOEXEC | O_NOFOLLOW | O_WRONLY | O_NONBLOCK);
       if (descriptor > 0) {
         // The fifo is open, The implication is that the other end also opened the fifo (for reading)
         USERMSG() << "Fifo successfully opened at " << fileName << std::endl;
+        LATCHY_PROBE1(fifo__open, fileName.c_str());
         break;
       } else {
         // It is an error. Some may be fatal but other not so...
@@ -160,53 +200,116 @@ namespace assetserver {
     }
   }
 
-  void assetProvider::deliverDataToFifo() {
-    // Now that the fifo is successfully opened we just need to write the data (using the assetProvider)
-    // We do not use anything fancy since we expect the data size to be relatively small and the other end
-    // quick at grabbing the data. So, instead of using select/poll/epoll, we presume the best (all the
-    // data fits in one go) and if not use a relatively small sleep delay.
+  void assetProvider::deliverDataToFifo(bool splice) {
+    // Now that the fifo is successfully opened we just need to write the data, from the pinned buffer. We may use
+    // vmsplice so that the pages are handed to the pipe instead of being copied through it. The pipe then
+    // references the pinned pages until the reader drains it. Should the kernel refuse, we fall back to a plain write.
     std::size_t  writtenSoFar = 0;
-    while (terminate == false) {
-      if (source->isReady() == true) {
-        // Write the data (using non blocking IO)
-        int      retval = write(descriptor, getBuffer() + writtenSoFar, getBufferSize() - writtenSoFar);
-        if (retval > 0) {
-          // We wrote some data. May be we are done!
-          writtenSoFar += retval;
-          if (writtenSoFar >= getBufferSize()) {
-            // We are done!!
-            break;
-          }
-        } if (retval == 0) {
-          // No data written, probably the IO Buffer is simply full. Lets wait a little...
-          std::this_thread::sleep_for(100ms);
-        } else {
-          //
-          // It is an error. Some may be fatal but other not so...
-          //
-          if (errno == EINTR) {
-            // Just an interrupt. Lets go at writing again immediately since this does not indicate a buffer full situation
-          } else if ( (errno == EWOULDBLOCK) or (errno == EAGAIN) ) {
-            // Not fatal but IO buffer full. We will try again shortly
-            std::this_thread::sleep_for(100ms);
-          } if (errno == EPIPE) {
-            // The other unexpectedly closed the pipe while we were still writting to it!!!
-            source->destroy();
-            close(descriptor);
-            throw brokenPipe(fileName);
-          } else {
-            // Anything else is fatal!
-            source->destroy();
-            close(descriptor);
-            throw openError(fileName, "Fatal error - " + std::string(strerror(errno)));
-          }
+    bool         useSplice = splice;
+    while ( (terminate == false) and (writtenSoFar < pinnedSize) ) {
+      ssize_t    retval;
+      if (useSplice == true) {
+        struct iovec   chunk = { pinned + writtenSoFar, pinnedSize - writtenSoFar };
+        retval = vmsplice(descriptor, &chunk, 1, SPLICE_F_NONBLOCK);
+        if ( (retval < 0) and ( (errno == EINVAL) or (errno == ENOSYS) ) ) {
+          DEBUG() << "vmsplice is not available for " << fileName << ", using write" << std::endl;
+          useSplice = false;
+          continue;
+        }
+      } else {
+        retval = write(descriptor, pinned + writtenSoFar, pinnedSize - writtenSoFar);
+      }
+
+      if (retval > 0) {
+        // We wrote some data. May be we are done!
+        spliced = spliced or useSplice;
+        if (writtenSoFar == 0) {
+          LATCHY_PROBE2(deliver__first, fileName.c_str(), retval);
         }
+        writtenSoFar += retval;
+      } else if ( (retval == 0) or (errno == EWOULDBLOCK) or (errno == EAGAIN) ) {
+        // The pipe is full, wait until the reader makes room
+        struct pollfd  room = { descriptor, POLLOUT, 0 };
+        poll(&room, 1, 250);
+      } else if (errno == EINTR) {
+        // Just an interrupt. Lets go at writing again immediately since this does not indicate a buffer full situation
+      } else if (errno == EPIPE) {
+        // The other unexpectedly closed the pipe while we were still writting to it!!!
+        spliced = false;      // No reader left, nothing can read the pages anymore
+        throw brokenPipe(fileName);
       } else {
-        // Wait for the data. Just wait a little
-        std::this_thread::sleep_for(250ms);
+        // Anything else is fatal!
+        throw openError(fileName, "Fatal error - " + std::string(strerror(errno)));
+      }
+    }
+  }
+
+  bool assetProvider::waitForReaderClose() {
+    // On the writing side of a pipe, POLLERR is reported once there is no reader left
+    while ( (terminate == false) and (isExpired() == false) ) {
+      struct pollfd  gone = { descriptor, 0, 0 };
+      if ( (poll(&gone, 1, 250) > 0) and (gone.revents & (POLLERR | POLLHUP)) ) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void assetProvider::pinBuffer() {
+    // Copy the plaintext, once, into memory that is locked (no swap) and excluded from core dumps
+    if (pinned != nullptr) {
+      return;
+    }
+    source->demand();     // A reader is there, a deferred unseal starts now
+    metrics::span   waiting(source->timing(), metrics::stage::waitSecret);
+    while ( (terminate == false) and (source->waitReady(readyPollInterval) == false) ) {}
+    if (terminate == true) {
+      throw genericError(fileName, "Terminated while waiting for the secret");
+    }
+    waiting.close();
+
+    std::size_t   size = getBufferSize();
+    std::size_t   page = sysconf(_SC_PAGESIZE);
+    pinnedCapacity = ((size / page) + 1) * page;
+    void*         area = mmap(nullptr, pinnedCapacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (area == MAP_FAILED) {
+      pinnedCapacity = 0;
+      throw genericError(fileName, "Can not allocate memory for the secret - " + std::string(strerror(errno)));
+    }
+    if (mlock(area, pinnedCapacity) != 0) {
+      USERMSG() << "Can not lock the memory holding " << fileName << " (RLIMIT_MEMLOCK?), it may be swapped" << std::endl;
+    }
+    madvise(area, pinnedCapacity, MADV_DONTDUMP);
+
+    memcpy(area, getBuffer(), size);
+    pinned = static_cast<char*>(area);
+    pinnedSize = size;
+    source->destroy();
+
+    if (ttl != 0s) {
+      deadline = std::chrono::steady_clock::now() + ttl;
+    }
+  }
+
+  void assetProvider::unpinBuffer() {
+    if (pinned != nullptr) {
+      // Pages still referenced by an undrained pipe (a spliced delivery cut short by the TTL or a termination)
+      // must not be touched, the reader would get zeros. They go back to the kernel once the pipe lets them go,
+      // like the copy a plain write leaves in a pipe
+      if (spliced == false) {
+        explicit_bzero(pinned, pinnedCapacity);
       }
+      munlock(pinned, pinnedCapacity);
+      munmap(pinned, pinnedCapacity);
+      pinned = nullptr;
+      pinnedSize = 0;
+      pinnedCapacity = 0;
+      spliced = false;
     }
+  }
 
+  bool assetProvider::isExpired() const {
+    return (pinned != nullptr) and (ttl != 0s) and (std::chrono::steady_clock::now() >= deadline);
   }
 
   void assetProvider::createRegularFile() {
@@ -232,14 +335,22 @@ namespace assetserver {
   }
 
   std::size_t assetProvider::writeToRegularFile() {
-    // Actual writing to the file
+    // Actual writing to the file, once the secret is there
     std::size_t  writtenSoFar = 0;
+    metrics::span   waiting(source->timing(), metrics::stage::waitSecret);
+    while ( (terminate == false) and (source->waitReady(readyPollInterval) == false) ) {}
+    waiting.close();
+
+    metrics::span   delivering(source->timing(), metrics::stage::delivery);
     while (terminate == false) {
-      if (source->isReady() == true) {
+      if (source->waitReady(readyPollInterval) == true) {
         // Write the data (using non blocking IO)
         int      retval = write(descriptor, getBuffer() + writtenSoFar, getBufferSize() - writtenSoFar);
         if (retval > 0) {
           // We wrote some data. May be we are done!
+          if (writtenSoFar == 0) {
+            LATCHY_PROBE2(deliver__first, fileName.c_str(), retval);
+          }
           writtenSoFar += retval;
           if (writtenSoFar >= getBufferSize()) {
             // We are done!!
@@ -268,9 +379,6 @@ namespace assetserver {
             throw openError(fileName, "Fatal error - " + std::string(strerror(errno)));
           }
         }
-      } else {
-        // Wait for the data. Just wait a little
-        std::this_thread::sleep_for(250ms);
       }
     }
 
@@ -308,6 +416,7 @@ namespace assetserver {
         struct inotify_event    *event = reinterpret_cast<struct inotify_event*> (current);
 
         while ( (event != nullptr) and (isDone == false) ) {
+          LATCHY_PROBE2(inotify__event, fileName.c_str(), event->mask);
           if ( event->mask & IN_ACCESS ) {
             // Read event, we do not anything just yet with this since this does not
             // indicate how much data was read. NOt very usefulll
@@ -323,11 +432,14 @@ namespace assetserver {
           if ( (event->mask & IN_CLOSE_WRITE ) or ( event->mask & IN_CLOSE_NOWRITE ) ){
             INFO() << "File " << fileName << " was closed, count is " << allocatedReadEvent << std::endl;
             ++closeEventCount;
-            if (allocatedReadEvent != 0) {
-              --allocatedReadEvent;
-            }
-            if ( (autoStop == true) and (allocatedReadEvent == 0) ) {
-              isDone = true;
+            if (autoStop == true) {
+              // Regular file. With a fifo, the provider task does the counting itself
+              if (allocatedReadEvent != 0) {
+                --allocatedReadEvent;
+              }
+              if (allocatedReadEvent == 0) {
+                isDone = true;
+              }
             }
           }
 
@@ -381,18 +493,18 @@ namespace assetserver {
         // std::cout writes to the buffer, which we will flush, may block. It is Ok. Although, we would prefer to not and delete
         // or destroy the source data as soon as possible.
 
+        metrics::span   waiting(source->timing(), metrics::stage::waitSecret);
         while (terminate == false) {
-          if (source->isReady() == true) {
+          if (source->waitReady(readyPollInterval) == true) {
             // Write the data, destroy and flush
+            waiting.close();
+            metrics::span delivering(source->timing(), metrics::stage::delivery);
             INFO() << "Providing unsealed secret on stdout" << std::endl;
             std::cout << source->getAsset();
             //logData(source->getAsset());
             source->destroy();
             std::cout.flush();
             terminate = true;
-          } else {
-            // Wait for the data. Just wait a little
-            std::this_thread::sleep_for(100ms);
           }
         }
 
@@ -406,4 +518,238 @@ namespace assetserver {
     });
   }
 
+  void assetProviderDescriptor::start() {
+    providerTask = std::async([&]() {
+      DEBUG() << "Starting the provider, feeding descriptor " << descriptor << std::endl;
+      try {
+        std::size_t  writtenSoFar = 0;
+        metrics::span   waiting(source->timing(), metrics::stage::waitSecret);
+        while (terminate == false) {
+          if (source->waitReady(readyPollInterval) == true) {
+            waiting.close();
+            // Blocking IO, the other end is expected to read everything we send
+            ssize_t  retval = write(descriptor, getBuffer() + writtenSoFar, getBufferSize() - writtenSoFar);
+            if (retval >= 0) {
+              writtenSoFar += retval;
+              if (writtenSoFar >= getBufferSize()) {
+                break;
+              }
+            } else if (errno != EINTR) {
+              throw std::runtime_error("Failed to write the secret to descriptor " + std::to_string(descriptor) + " - " + std::string(strerror(errno)));
+            }
+          }
+        }
+
+        source->destroy();
+      } catch(std::exception &exc) {
+        USERMSG() << "Unexpected error while output to descriptor - " << exc.what() << std::endl;
+        source->destroy();
+        throw;
+      }
+    });
+  }
+
+  void assetProviderSocket::start() {
+    // Listen right away, so that configuration errors are reported before anything else runs
+    listenDescriptor = helpers::unixSocket::listenOn(socketPath);
+
+    providerTask = std::async([&]() {
+      logger::context     asset(socketPath);
+      INFO() << "Starting socket provider for " << socketPath << std::endl;
+      try {
+        while ( (terminate == false) and (handouts < allocatedHandouts) and (isExpired() == false) ) {
+          int                 peer = helpers::unixSocket::acceptPeer(listenDescriptor, readyPollInterval);
+          if (peer < 0) {
+            continue;
+          }
+
+          try {
+            if (helpers::unixSocket::isAuthorized(peer) == true) {
+              createSealedCopy();
+              if (secretDescriptor >= 0) {
+                metrics::span   delivering(source->timing(), metrics::stage::delivery);
+                // Each client gets its own open file description, hence its own offset. Sharing ours would have
+                // one client's read() move where the next one starts
+                int             handout = open(("/proc/self/fd/" + std::to_string(secretDescriptor)).c_str(), O_RDONLY | O_CLOEXEC);
+                if (handout < 0) {
+                  throw std::runtime_error("Can not reopen the memfd - " + std::string(strerror(errno)));
+                }
+                try {
+                  helpers::unixSocket::sendDescriptor(peer, handout, "");
+                } catch (std::exception& exc) {
+                  close(handout);
+                  throw;
+                }
+                close(handout);
+                ++handouts;
+                INFO() << "Handed " << socketPath << " to a client, " << (allocatedHandouts - handouts) << " left" << std::endl;
+              }
+            }
+          } catch (std::exception& exc) {
+            // That peer is lost, others may still come
+            USERMSG() << "Failed to hand the secret over " << socketPath << " - " << exc.what() << std::endl;
+          }
+          close(peer);
+        }
+      } catch (std::exception& exc) {
+        source->destroy();
+        helpers::unixSocket::closeListener(listenDescriptor, socketPath);
+        if (secretDescriptor >= 0) {
+          close(secretDescriptor);
+        }
+        throw;
+      }
+
+      // Normal ending. Peers keep their own descriptor (and therefore the content) for as long as they want
+      source->destroy();
+      helpers::unixSocket::closeListener(listenDescriptor, socketPath);
+      if (secretDescriptor >= 0) {
+        close(secretDescriptor);
+        secretDescriptor = -1;
+      }
+      USERMSG() << "Completed providing " << socketPath << " to " << handouts << " client(s)" << std::endl;
+    });
+  }
+
+  void assetProviderSocket::createSealedCopy() {
+    // Once only. The memfd is then sealed so that no one, including us, can change it anymore.
+    if (secretDescriptor >= 0) {
+      return;
+    }
+    source->demand();     // An authorised peer is there, a deferred unseal starts now
+    metrics::span         waiting(source->timing(), metrics::stage::waitSecret);
+    while ( (terminate == false) and (source->waitReady(readyPollInterval) == false) ) {}
+    if (terminate == true) {
+      return;
+    }
+    waiting.close();
+
+    int                   fd = memfd_create("latchy-secret", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0) {
+      throw std::runtime_error("Can not create a memfd - " + std::string(strerror(errno)));
+    }
+
+    std::size_t           writtenSoFar = 0;
+    while (writtenSoFar < getBufferSize()) {
+      ssize_t             retval = write(fd, getBuffer() + writtenSoFar, getBufferSize() - writtenSoFar);
+      if (retval < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        std::string       reason(strerror(errno));
+        close(fd);
+        throw std::runtime_error("Can not fill the memfd - " + reason);
+      }
+      writtenSoFar += retval;
+    }
+
+    if (fcntl(fd, F_ADD_SEALS, F_SEAL_WRITE | F_SEAL_GROW | F_SEAL_SHRINK | F_SEAL_SEAL) != 0) {
+      std::string         reason(strerror(errno));
+      close(fd);
+      throw std::runtime_error("Can not seal the memfd - " + reason);
+    }
+
+    // The only copy left is in the memfd
+    source->destroy();
+    secretDescriptor = fd;
+    if (ttl != 0s) {
+      deadline = std::chrono::steady_clock::now() + ttl;
+    }
+  }
+
+  assetProviderExec::assetProviderExec(std::shared_ptr<assetSource<std::string>> p, const os::launch::cmdLine_t& cmdline, int fd, bool r): assetProviderBase<std::string>(p), commandLine(cmdline), targetDescriptor(fd), replace(r) {
+    if (commandLine.empty() == true) {
+      throw std::runtime_error("Missing command line for the workload");
+    }
+  }
+
+  void assetProviderExec::start() {
+    providerTask = std::async([&]() {
+      logger::context     asset(commandLine[0]);
+      try {
+        metrics::span     waiting(source->timing(), metrics::stage::waitSecret);
+        while ( (terminate == false) and (source->waitReady(readyPollInterval) == false) ) {}
+        if (terminate == true) {
+          source->destroy();
+          return;
+        }
+        waiting.close();
+
+        if (replace == true) {
+          execInPlace();    // Does not return, unless it failed
+        }
+
+        // The workload gets its end of the pipe as targetDescriptor and we stream the secret into the other end
+        INFO() << "Starting " << commandLine[0] << " with the secret on descriptor " << targetDescriptor << std::endl;
+        metrics::span     delivering(source->timing(), metrics::stage::delivery);
+        os::launch::exec      child(commandLine, false, true, false, false, targetDescriptor);
+        try {
+          child.sendBuffer(source->getAsset(), true);
+        } catch(std::runtime_error &exc) {
+          // The workload may exit, or close its descriptor, before taking the secret. Its exit code is what matters
+          INFO() << commandLine[0] << " did not take the secret - " << exc.what() << std::endl;
+        }
+        source->destroy();
+        delivering.close();
+
+        childExitCode = child.exitCode();
+        child.clearBuffer();
+        USERMSG() << commandLine[0] << " exited with code " << childExitCode << std::endl;
+      } catch(std::exception &exc) {
+        USERMSG() << "Unexpected error while starting " << commandLine[0] << " - " << exc.what() << std::endl;
+        source->destroy();
+        throw;
+      }
+    });
+  }
+
+  void assetProviderExec::execInPlace() {
+    // The secret must be entirely in the pipe before the exec since nobody will be left to write it. The
+    // pipe is grown when needed, up to what the system allows.
+    int                   fds[2];
+    if (pipe(fds) != 0) {
+      throw launchError(commandLine[0], "Can not create pipe - " + std::string(strerror(errno)));
+    }
+
+    if (getBufferSize() > (std::size_t) fcntl(fds[1], F_GETPIPE_SZ)) {
+      fcntl(fds[1], F_SETPIPE_SZ, (int) getBufferSize());
+    }
+    if (getBufferSize() > (std::size_t) fcntl(fds[1], F_GETPIPE_SZ)) {
+      close(fds[0]);
+      close(fds[1]);
+      throw launchError(commandLine[0], "Secret is too large to be handed over when replacing latchy");
+    }
+
+    std::size_t           writtenSoFar = 0;
+    while (writtenSoFar < getBufferSize()) {
+      ssize_t             retval = write(fds[1], getBuffer() + writtenSoFar, getBufferSize() - writtenSoFar);
+      if (retval < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        std::string       reason(strerror(errno));
+        close(fds[0]);
+        close(fds[1]);
+        throw launchError(commandLine[0], "Can not write to the pipe - " + reason);
+      }
+      writtenSoFar += retval;
+    }
+    close(fds[1]);
+    source->destroy();
+
+    if (fds[0] != targetDescriptor) {
+      dup2(fds[0], targetDescriptor);    // The duplicate does not have FD_CLOEXEC
+      close(fds[0]);
+    }
+
+    USERMSG() << "Replacing latchy with " << commandLine[0] << std::endl;
+    logger::flush();
+    std::cout.flush();
+    std::cerr.flush();
+
+    os::launch::cmdArgList_t    arg(commandLine.begin() + 1, commandLine.end());
+    os::launch::execvpe(commandLine[0], arg, os::launch::cmdEnvList_t());
+    throw launchError(commandLine[0], std::string(strerror(errno)));
+  }
+
 } // namespace assetserver
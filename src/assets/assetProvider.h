@@ -25,6 +25,7 @@
 #include <stdio.h>
 
 #include "assetSource.h"
+#include "helpers/forkExec.h"
 namespace assetserver {
   /// Asset provider
   ///
@@ -51,6 +52,7 @@ namespace assetserver {
     virtual void                        start() =0;
     virtual std::future_status          wait(const std::chrono::nanoseconds duration = std::chrono::seconds(0)) const { if (providerTask.valid() == true) { return providerTask.wait_for(duration); } return std::future_status::timeout; };
     virtual void                        get() { if (providerTask.valid() == true) { providerTask.get(); } };
+    virtual void                        cancel() { terminate = true; };    // Give up delivering, such as when the declaration is withdrawn
 
   protected:
     std::shared_ptr<assetSource<T>>     source = nullptr;
@@ -63,6 +65,7 @@ namespace assetserver {
 
     std::atomic<bool>                   terminate = false;      // Flag, mostly used to signal the task to terminate
     std::chrono::seconds                stopDelay = 0s;         // Generic delay to extend the processing for example when we want to make sure inotify catches all events
+    std::chrono::milliseconds           readyPollInterval = 250ms;  // Upper bound on how long we block on the source readiness before checking terminate again
   };
 
   template<>
@@ -85,7 +88,7 @@ namespace assetserver {
   /// Asset provider handling files and pipes
   class assetProvider: public assetProviderBase<std::string> {
   public:
-    assetProvider(std::shared_ptr<assetSource<std::string>> p, const std::string& f, std::size_t c, bool fifo);
+    assetProvider(std::shared_ptr<assetSource<std::string>> p, const std::string& f, std::size_t c, bool fifo, std::chrono::seconds ttl = 0s);
     virtual ~assetProvider() { stop(); };
 
     //bool                                isReady() const { return ready; };
@@ -98,7 +101,7 @@ namespace assetserver {
 
   protected:
     std::string                         fileName;
-    std::size_t                         allocatedReadEvent;          // Number of file read we count before destroying the file (for regular file mode of operation)
+    std::size_t                         allocatedReadEvent;          // Number of file read (or successive fifo readers) we count before destroying the secret
     bool                                useFifo;                     // Output to a named pipe when true
 
     int                                 descriptor = 0;
@@ -115,7 +118,19 @@ namespace assetserver {
     // Named pipe (or Fifo) helper methods
     void                                prepareFifo();               // Prepare a fifo (named pipe). This completes once the other end ALSO opened (for reading)
     virtual void                        postFifoPreparation() { };   // Additional processing after the named pipe (fifo) is opened. If any....
-    void                                deliverDataToFifo();
+    void                                deliverDataToFifo(bool splice);   // splice only when the reader is waited for afterwards, see unpinBuffer()
+    bool                                waitForReaderClose();        // False when terminated or expired first
+
+    // Plaintext kept in locked memory while the fifo serves successive readers
+    void                                pinBuffer();
+    void                                unpinBuffer();
+    bool                                isExpired() const;
+    char*                               pinned = nullptr;
+    std::size_t                         pinnedSize = 0;
+    std::size_t                         pinnedCapacity = 0;
+    bool                                spliced = false;             // Pinned pages were handed to a pipe that may not be drained yet
+    std::chrono::seconds                ttl = 0s;                    // How long the pinned plaintext is kept around. 0 is forever
+    std::chrono::steady_clock::time_point deadline;
                       
 
     // Regular file  helper methods
@@ -157,6 +172,68 @@ namespace assetserver {
 
   };
 
+  /// Asset provider writing to an already open descriptor, such as a connected socket. The descriptor is
+  /// owned by the caller and is left open.
+  class assetProviderDescriptor: public assetProviderBase<std::string> {
+  public:
+    assetProviderDescriptor(std::shared_ptr<assetSource<std::string>> p, int fd): assetProviderBase<std::string>(p), descriptor(fd) { };
+    virtual ~assetProviderDescriptor() { terminate = true; };
+
+    virtual void                        start();
+
+  protected:
+    int                                 descriptor = -1;
+  };
+
+  /// Asset provider listening on a Unix socket. Each authorised peer (SO_PEERCRED) receives, via SCM_RIGHTS,
+  /// a descriptor to a sealed memfd holding the secret. The peer can mmap it; nothing touches the filesystem
+  /// and the number of reads is the number of handouts.
+  class assetProviderSocket: public assetProviderBase<std::string> {
+  public:
+    assetProviderSocket(std::shared_ptr<assetSource<std::string>> p, const std::string& path, std::size_t c, std::chrono::seconds t = 0s): assetProviderBase<std::string>(p), socketPath(path), allocatedHandouts(c), ttl(t) { };
+    virtual ~assetProviderSocket() { terminate = true; };
+
+    virtual void                        start();
+
+  protected:
+    std::string                         socketPath;
+    std::size_t                         allocatedHandouts;           // Number of peers we serve before destroying the secret
+    std::size_t                         handouts = 0;
+    std::chrono::seconds                ttl = 0s;                    // How long the secret is handed out once available. 0 is forever
+    std::chrono::steady_clock::time_point deadline;
+
+    int                                 listenDescriptor = -1;
+    int                                 secretDescriptor = -1;       // The sealed memfd
+
+    void                                createSealedCopy();
+    bool                                isExpired() const { return (secretDescriptor >= 0) and (ttl != 0s) and (std::chrono::steady_clock::now() >= deadline); };
+  };
+
+  /// Asset provider starting the workload itself (see os::launch) and streaming the secret into its stdin,
+  /// or into another inherited descriptor. When replace is set, latchy execs in place and becomes the
+  /// workload, the secret waiting in a pipe. Nothing is written to the filesystem.
+  class assetProviderExec: public assetProviderBase<std::string> {
+  public:
+    assetProviderExec(std::shared_ptr<assetSource<std::string>> p, const os::launch::cmdLine_t& cmdline, int fd = STDIN_FILENO, bool r = false);
+    virtual ~assetProviderExec() { terminate = true; };
+
+    virtual void                        start();
+
+  protected:
+    os::launch::cmdLine_t               commandLine;
+    int                                 targetDescriptor = STDIN_FILENO;   // In the workload
+    bool                                replace = false;
+    int                                 childExitCode = -1;
+
+    void                                execInPlace();             // Only returns on failure
+
+  public:
+    class launchError: public std::runtime_error {
+    public:
+      launchError(const std::string& binary, const std::string& msg = ""): runtime_error("Failed to launch " + binary + ((msg.empty() == false) ? (" - " + msg) : "")) { };
+    };
+  };
+
   // Few helpers
   inline void logData(const std::string &buffer) {
     //LOGTOFILE(std::string("**************** DO NOT PUT INTO PRODUCTION WITH LOGGING ENABLED *********** \nSecret outputed: ") + jose::toB64(buffer) + "\n");
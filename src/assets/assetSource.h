@@ -20,6 +20,9 @@
 #include <filesystem>
 #include <future>
 #include <chrono>
+#include <atomic>
+#include <exception>
+#include <mutex>
 
 #include <iostream>
 #include <fstream>
@@ -28,6 +31,7 @@
 
 #include "configuration.h"
 #include "helpers/log.h"
+#include "helpers/metrics.h"
 #include "metaInfo/metaInfo.h"
 
 #include "curl.h"
@@ -47,16 +51,29 @@ namespace assetserver {
     virtual ~assetSource() {};
 
     virtual void                    cancel() { isCancelled = true; }
+    virtual void                    demand() { }               /// A client is waiting for the asset. Sources deferring their work (see assetFileClevis) proceed
 
     virtual bool                    isReady() const =0;        /// The underlying asset is available.
+    virtual bool                    waitReady(std::chrono::nanoseconds timeout) const;   /// Block until the asset is available or the timeout expires. Source failures are rethrown here
     virtual const T&                getAsset() =0;             /// Get the underlying asset.
     virtual void                    destroy() =0;              /// Delete or otherwise destroy the underlying asset. An example of destruction is to write 0 to memory space occupied by a secret.
 
     virtual void                    dumpInfo(bool all = false) const =0;       /// Output significant data, mostly upon user request, such as dumping the JWE content
     virtual void                    printInfo() const =0;      /// Output operational information, typically for debugging purpose 
+
+    const metrics::timeline_p&      timing() const { return timeline; }   /// Stage latencies of this asset, shared with its provider
   protected:
     std::atomic<bool>               isCancelled = false;
+    metrics::timeline_p             timeline = std::make_shared<metrics::timeline>();
     bool                            destroyed = false;
+
+    // Readiness notification. Derived classes signal once, either when the asset becomes available or
+    // when producing it failed. Providers block on readyEvent instead of polling isReady().
+    void                            notifyReady();
+    void                            notifyFailure(std::exception_ptr exc);
+    std::promise<void>              readyPromise;
+    std::shared_future<void>        readyEvent = readyPromise.get_future().share();
+    std::atomic<bool>               readyNotified = false;
   public:
     class error: public std::runtime_error {
     public:
@@ -70,6 +87,29 @@ namespace assetserver {
     };
   };
 
+  template <typename T>
+  inline bool assetSource<T>::waitReady(std::chrono::nanoseconds timeout) const {
+    if (readyEvent.wait_for(timeout) == std::future_status::ready) {
+      readyEvent.get();   // So that exceptions can percolate up
+      return isReady();
+    }
+    return false;
+  }
+
+  template <typename T>
+  inline void assetSource<T>::notifyReady() {
+    if (readyNotified.exchange(true) == false) {
+      readyPromise.set_value();
+    }
+  }
+
+  template <typename T>
+  inline void assetSource<T>::notifyFailure(std::exception_ptr exc) {
+    if (readyNotified.exchange(true) == false) {
+      readyPromise.set_exception(exc);
+    }
+  }
+
   //
   // Some derived asset source classes
   //
@@ -77,7 +117,7 @@ namespace assetserver {
   // A simple string based source. Mostly used for testing
   class assetStaticString: public assetSource<std::string> {
   public:
-    assetStaticString(const std::string& d): buffer(d) {};
+    assetStaticString(const std::string& d): buffer(d) { notifyReady(); };
     virtual ~assetStaticString() {};
 
     virtual bool                    isReady() const { return !destroyed; };
@@ -88,12 +128,20 @@ namespace assetserver {
     mutable std::string             buffer;
   };
 
+  // Content that was already received by other means (for example over a socket) and that is handed
+  // to a file based source instead of having it read the filesystem or STDIN.
+  struct inMemory {
+    const std::string&              content;
+  };
+
   // The source is a file. Or STDIN (when no filename path is provided)
-  // We use a synchronous method. In other words, we expect the data to be immediately readable from the filesystem
+  // The file (or named pipe) is open without blocking, the content is only read on the first getAsset(). With a
+  // named pipe, that read waits for a writer to come and go.
   class assetFile: public assetSource<std::string> {
   public:
-    assetFile(const std::string& f);
-    virtual ~assetFile() {};
+    assetFile(const std::string& f, bool readyOnOpen = true);   // readyOnOpen is false for derived classes that still need to process the content
+    assetFile(const inMemory& m, bool readyOnOpen = true);
+    virtual ~assetFile();
 
     virtual bool                    isReady() const { return !destroyed; };   // The object is constructed, which implies that the file exists and is readable (can be open)
     virtual const std::string&      getAsset();
@@ -103,9 +151,11 @@ namespace assetserver {
     virtual void                    printInfo() const { };
   protected:
     std::filesystem::path           filePath;
-    std::ifstream                   inputStream;
+    int                             inputDescriptor = -1;     // O_NONBLOCK
     bool                            useCin = false;
 
+    void                            readInput();              // Until EOF, or until cancelled
+
   protected:
     mutable std::string             buffer;
   };
@@ -114,12 +164,19 @@ namespace assetserver {
   //
   // The base class, assetFile provides the JWE. An async thread will extract the secret from it.
   //
+  // The JWE is always read and validated right away. With the LAZY policy, the Tang exchange and the decryption
+  // then wait for demand(), with KEYFIRST only the decryption does (the unwrapping key is held meanwhile).
+  //
   class assetFileClevis: public assetFile {
   public:
-    assetFileClevis(const std::string& f, const meta::composition& m, bool autoStart, bool compatibleMode);
-    virtual ~assetFileClevis() { cancel(); freeJson(); };
+    using unsealPolicy_t =          model::latchy::unsealPolicies;
+
+    assetFileClevis(const std::string& f, const meta::composition& m, bool autoStart, bool compatibleMode, unsealPolicy_t policy = unsealPolicy_t::EAGER, std::uint32_t priority = 0);
+    assetFileClevis(const inMemory& jwe, const meta::composition& m, bool autoStart, bool compatibleMode, unsealPolicy_t policy = unsealPolicy_t::EAGER, std::uint32_t priority = 0);
+    virtual ~assetFileClevis() { cancel(); if (jweExtractTask.valid() == true) { jweExtractTask.wait(); } freeJson(); };
 
     void                            startUnsealing();
+    virtual void                    demand() { if (demandSignaled.exchange(true) == false) { demandPromise.set_value(); } };
 
     virtual bool                    isReady() const;   // The asset is only available after the unlocking step is complete (using Tang)
     virtual const std::string&      getAsset() { return buffer; };
@@ -129,9 +186,16 @@ namespace assetserver {
   protected:
     bool                            compatibleMode = false;
     const meta::composition&        meta;
-    mutable std::future<void>       jweExtractTask;    // We will be using an std::async to extract from the JWE...
+    mutable std::future<void>       jweExtractTask;    // We will be using an std::async to extract from the JWE... Completion is signaled via readyEvent
     mutable std::atomic<bool>       isDone = false;
 
+    unsealPolicy_t                  policy = unsealPolicy_t::EAGER;
+    std::uint32_t                   priority = 0;      // Order among the requests queued for a saturated Tang (see tangScheduler)
+    std::promise<void>              demandPromise;
+    std::shared_future<void>        demanded = demandPromise.get_future().share();
+    std::atomic<bool>               demandSignaled = false;
+    bool                            awaitDemand();     // False when cancelled first
+
     void                            baseJWEProcessing();
     void                            jweExtract();      // Actual secret extraction. This typically runs in its own thread (see startUnsealing())
     void                            recoverPrivateKey();
@@ -187,5 +251,73 @@ namespace assetserver {
     void                            failedPrint() const;
   };
 
+  // One user of a source shared by several declarations, such as the same JWE delivered to a named pipe and to
+  // a file (see assets::list). Everything goes to the shared source, which unseals once for all of them. It is
+  // only destroyed when every view was destroyed, or went away.
+  class assetShared: public assetSource<std::string> {
+  public:
+    using source_p =                std::shared_ptr<assetSource<std::string>>;
+
+    // What the views of a source have in common
+    class group {
+    public:
+      group(const source_p& s): source(s) { };
+
+      bool                          join();            // False when the source is destroyed or failed, a new one is needed
+      void                          leave();           // The last one out destroys the source
+      const source_p                source;
+    private:
+      std::mutex                    access;
+      std::size_t                   users = 0;
+      bool                          released = false;
+    };
+    using group_p =                 std::shared_ptr<group>;
+
+    assetShared(const group_p& g): shared(g) { timeline = shared->source->timing(); };    // g must have been joined
+    virtual ~assetShared() { leave(); };
+
+    virtual void                    demand() { shared->source->demand(); };
+    virtual bool                    isReady() const { return (left == false) and shared->source->isReady(); };
+    virtual bool                    waitReady(std::chrono::nanoseconds timeout) const { return (left == false) and shared->source->waitReady(timeout); };
+    virtual const std::string&      getAsset() { return shared->source->getAsset(); };
+    virtual void                    destroy() { leave(); };
+
+    virtual void                    dumpInfo(bool all = false) const { shared->source->dumpInfo(all); };
+    virtual void                    printInfo() const { shared->source->printInfo(); };
+  private:
+    group_p                         shared;
+    std::atomic<bool>               left = false;
+
+    void                            leave() { if (left.exchange(true) == false) { shared->leave(); } };
+  };
+
+  // One member of a bundle, a JWE whose plaintext is a JSON object of named secrets. The bundle comes from
+  // another source, typically shared with the other members (see assetShared), and is only parsed once it is
+  // ready. A string member is the secret itself, any other value is handed out as compact JSON.
+  class assetMember: public assetSource<std::string> {
+  public:
+    using source_p =                std::shared_ptr<assetSource<std::string>>;
+
+    assetMember(const source_p& b, const std::string& m): bundle(b), member(m) { timeline = bundle->timing(); };
+    virtual ~assetMember() { if (destroyed == false) { destroy(); } };
+
+    virtual void                    demand() { bundle->demand(); };
+    virtual bool                    isReady() const { return (destroyed == false) and bundle->isReady() and extract(); };
+    virtual bool                    waitReady(std::chrono::nanoseconds timeout) const { return (destroyed == false) and bundle->waitReady(timeout) and extract(); };
+    virtual const std::string&      getAsset() { return buffer; };
+    virtual void                    destroy();
+
+    virtual void                    dumpInfo(bool all = false) const { bundle->dumpInfo(all); };
+    virtual void                    printInfo() const { bundle->printInfo(); };
+  private:
+    source_p                        bundle;
+    const std::string               member;
+    mutable std::mutex              access;
+    mutable std::string             buffer;
+    mutable bool                    extracted = false;
+
+    bool                            extract() const;  // Throws unavailable when the bundle does not hold the member
+  };
+
 } // namespace assetserver
 
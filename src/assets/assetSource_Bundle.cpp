@@ -0,0 +1,95 @@
+/*
+ * Copyright 2024 NearEDGE, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "assetSource.h"
+
+#include <cstring>
+#include <cstdlib>
+
+namespace assetserver {
+
+  namespace {
+    // jansson frees without clearing, wipe the secrets first
+    void wipe(json_t* value) {
+      if (json_is_string(value)) {
+        std::memset(const_cast<char*>(json_string_value(value)), 0, json_string_length(value));
+      } else if (json_is_object(value)) {
+        const char*                 key;
+        json_t*                     item;
+        json_object_foreach(value, key, item) {
+          wipe(item);
+        }
+      } else if (json_is_array(value)) {
+        std::size_t                 index;
+        json_t*                     item;
+        json_array_foreach(value, index, item) {
+          wipe(item);
+        }
+      }
+    }
+  }
+
+  //
+  // A member of a bundle. The bundle is parsed by the first member call after it became ready
+  //
+
+  bool assetMember::extract() const {
+    std::lock_guard<std::mutex>     lock(access);
+    if (extracted == true) {
+      return true;
+    }
+
+    const std::string&              plaintext = bundle->getAsset();
+    json_t*                         content = json_loadb(plaintext.data(), plaintext.size(), 0, nullptr);
+    if (json_is_object(content) == false) {
+      if (content != nullptr) {
+        wipe(content);
+        json_decref(content);
+      }
+      throw unavailable("The secret is not a bundle (a JSON object), can not deliver its member " + member);
+    }
+
+    json_t*                         value = json_object_get(content, member.c_str());
+    if (value == nullptr) {
+      wipe(content);
+      json_decref(content);
+      throw unavailable("The bundle has no member " + member);
+    }
+    if (json_is_string(value)) {
+      buffer.assign(json_string_value(value), json_string_length(value));
+    } else {
+      char*                         dumped = json_dumps(value, JSON_COMPACT);
+      if (dumped != nullptr) {
+        buffer.assign(dumped);
+        std::memset(dumped, 0, buffer.size());
+        std::free(dumped);
+      }
+    }
+    wipe(content);
+    json_decref(content);
+
+    extracted = true;
+    DEBUG() << "Extracted member " << member << " from its bundle" << std::endl;
+    return true;
+  }
+
+  void assetMember::destroy() {
+    std::lock_guard<std::mutex>     lock(access);
+    buffer.assign(buffer.size(), (char) 0);
+    destroyed = true;
+    bundle->destroy();      // Shared with the other members, the bundle itself is only wiped by the last one
+  }
+
+} // namespace assetserver
@@ -19,6 +19,9 @@
 #include <thread>
 
 #include "helpers/log.h"
+#include "helpers/probes.h"
+#include "helpers/startup.h"
+#include "tangScheduler.h"
 
 #include "clevisEncrypt.h"
 #include "jose/joseCommon.h"
@@ -34,23 +37,42 @@ namespace assetserver {
   // tang pins is doing.
   //
 
-  assetFileClevis::assetFileClevis(const std::string& f, const meta::composition& m, bool autoStart, bool c): assetFile(f), meta(m), compatibleMode(c) {
+  assetFileClevis::assetFileClevis(const std::string& f, const meta::composition& m, bool autoStart, bool c, unsealPolicy_t p, std::uint32_t prio): assetFile(f, false), meta(m), compatibleMode(c), policy(p), priority(prio) {
     // The base class already makes sure that the input JWE file is there and readable.
     // All is left is to
-    // - perform the base processing, which includes validation of the JWE
+    // - perform the base processing, which includes reading and validating the JWE
     // - extract the secret from the JWE. We do this via an async activity
+    //
+    // When unsealing right away, the base processing is part of that async activity. A named pipe waiting for
+    // its writer, or a slow STDIN, then only holds this very secret and the Tang exchange starts as soon as its
+    // own input is complete. Failures are reported through the readiness, like any unsealing failure.
+    if (autoStart == true) {
+      startUnsealing();
+    } else {
+      baseJWEProcessing();
+    }
+  }
 
-    // Basic validation (and decomposition of the JWE). 
+  assetFileClevis::assetFileClevis(const inMemory& jwe, const meta::composition& m, bool autoStart, bool c, unsealPolicy_t p, std::uint32_t prio): assetFile(jwe, false), meta(m), compatibleMode(c), policy(p), priority(prio) {
+    // Same as above, except that the JWE was handed to us instead of being read from a file or STDIN
     baseJWEProcessing();
 
-    // Actual secret extration. If requested....
     if (autoStart == true) {
       startUnsealing();
     }
   }
 
   void assetFileClevis::startUnsealing() {
-    jweExtractTask = std::async([&]() { jweExtract(); });
+    jweExtractTask = std::async(std::launch::async, [&]() { jweExtract(); });
+  }
+
+  bool assetFileClevis::awaitDemand() {
+    while (demanded.wait_for(250ms) != std::future_status::ready) {
+      if (isCancelled == true) {
+        return false;
+      }
+    }
+    return true;
   }
 
   bool assetFileClevis::isReady() const {
@@ -58,8 +80,8 @@ namespace assetserver {
       return true;
     }
 
-    if ( (jweExtractTask.valid()) and (jweExtractTask.wait_for(0s) == std::future_status::ready) ) {
-      jweExtractTask.get();   // We do this so that exceptions can percolate up
+    if (readyEvent.wait_for(0s) == std::future_status::ready) {
+      readyEvent.get();   // We do this so that exceptions can percolate up
       isDone = true;
       return true;
     }
@@ -70,6 +92,8 @@ namespace assetserver {
   void assetFileClevis::baseJWEProcessing() {
     // First, lets get the JWE
     const std::string&      jwe = assetFile::getAsset();
+    startup::mark("first JWE read");
+    metrics::span           validating(timeline, metrics::stage::validate);
     jwe_j = joseLibWrapper::decrypt::decomposeCompactJWE(jwe);
 
     // Check the validity of the JWE and extract references to the various
@@ -92,22 +116,45 @@ namespace assetserver {
     checker.printProtectedHeader();
     checker.printEPK();
     checker.printSelectedServerKey();
+    startup::mark("first JWE validated");
   }
 
   void assetFileClevis::jweExtract() {
+    logger::context         asset(useCin ? "stdin" : filePath.string());
     try {
-      // Extract the secret. First by recovering the encryption key, using tang. And then decryting the payload 
+      if (jwe_j == nullptr) {
+        // Deferred reading and validation of the JWE, see the constructor
+        baseJWEProcessing();
+      }
+
+      // Extract the secret. First by recovering the encryption key, using tang. And then decryting the payload.
+      // Either step may wait for a client first, depending on the policy
+      if ( (policy == unsealPolicy_t::LAZY) and (awaitDemand() == false) ) {
+        notifyFailure(std::make_exception_ptr(unavailable("Withdrawn before any client came")));
+        return;
+      }
       INFO() << "Recover private key" << (filePath.string().empty() ? "" : " for " + filePath.string()) << std::endl;
       recoverPrivateKey();
 
+      if ( (policy == unsealPolicy_t::KEYFIRST) and (awaitDemand() == false) ) {
+        notifyFailure(std::make_exception_ptr(unavailable("Withdrawn before any client came")));
+        return;
+      }
+
       INFO() << "Finally, recover the payload / secret" <<   (filePath.string().empty() ? "" : " from " + filePath.string()) << std::endl;
+      metrics::span         decrypting(timeline, metrics::stage::decryption);
+      LATCHY_PROBE2(decrypt__start, filePath.c_str(), buffer.size());
       buffer = joseLibWrapper::decrypt::recoverPayload(unwrappingJWK_j, jwe_j);
       jwk.assign(jwk.size(), (char) 0);
+      LATCHY_PROBE2(decrypt__done, filePath.c_str(), buffer.size());
+      decrypting.close();
 
       DEBUG() << "Recovered clear-text secret" << std::endl;
+      notifyReady();    // Wake up the provider, the plaintext can leave immediately
     } catch (std::exception& exc) {
-      // Just rethrow after alerting the user
+      // Just rethrow after alerting the user. The provider waiting on us gets the exception as well
       failedPrint();
+      notifyFailure(std::current_exception());
       throw;
     }
   }
@@ -123,8 +170,13 @@ namespace assetserver {
     // is done via an interaction with the Tang server.
     json_auto_t*                  ephemeralKey_j = nullptr;
     std::string                   exchangeKey_pub;
+
+    // jose must not be the first to use OpenSSL (see curlWrapper::globalInit). The initialisation started in the
+    // background with the asset list, it is usually over by now
+    curlWrapper::globalInit();
     try {
     // This series of action may throw an exception
+    metrics::span                 generating(timeline, metrics::stage::keyGeneration);
     ephemeralKey_j = joseLibWrapper::generateKey(epkCurve_j);   // This is a full pairwise key, i.e. the private part is present
     DEBUG() << "Ephemeral Key, this is the private part: " << joseLibWrapper::prettyPrintJson(ephemeralKey_j) << std::endl;
 
@@ -136,13 +188,28 @@ namespace assetserver {
     exchangedKey2_pub = joseLibWrapper::keyExchange(ephemeralKey_j, activeServerKey_j);
     DEBUG() << "Known public key from server: " << joseLibWrapper::prettyPrintJson(activeServerKey_j) << std::endl;
     DEBUG() << "Ephemeral Key, after exchange2: " << joseLibWrapper::prettyPrintJson(exchangedKey2_pub) << std::endl;
+    generating.close();
 
  
     std::string                   recoveringKey_pubFromTang;
+    int                           retries = 0;
     std::chrono::time_point<std::chrono::steady_clock, std::chrono::nanoseconds>   giveUpTime(std::chrono::steady_clock::now() + 5h);
     while (!isCancelled) {
       try {
-        recoveringKey_pubFromTang = curlWrapper::keyRecoverViaTang(extractedUrl, json_string_value(kid_j), exchangeKey_pub, queryString(), isCancelled);
+        std::string               query;
+        {
+          metrics::span           waiting(timeline, metrics::stage::metadata);   // Only the first request may wait for the metadata
+          query = queryString();
+        }
+        metrics::span             queueing(timeline, metrics::stage::tangQueue);
+        curlWrapper::awaitCircuit(extractedUrl, isCancelled);         // Not holding a slot while the server is down
+        tangScheduler::slot       admission(extractedUrl, priority, isCancelled);
+        queueing.close();
+        if (admission.admitted() == false) {
+          throw unavailable("Cancelled while waiting for Tang");
+        }
+        metrics::span             exchanging(timeline, metrics::stage::tangExchange);
+        recoveringKey_pubFromTang = curlWrapper::keyRecoverViaTang(extractedUrl, json_string_value(kid_j), exchangeKey_pub, query, isCancelled);
         exchangeKey_pub.assign(exchangeKey_pub.size(), (char) 0);  // Clear the memory
         break;
       } catch (curlWrapper::notFoundTangFailure& exc) {
@@ -151,6 +218,10 @@ namespace assetserver {
         if (compatibleMode == false) {
           // Lets try with the compatible mode next time...
           compatibleMode = true;
+          timeline->retry();
+          ++retries;
+          LATCHY_PROBE3(tang__retry, filePath.c_str(), retries, 1000);
+          metrics::span           backingOff(timeline, metrics::stage::retryWait);
           std::this_thread::sleep_for (1s);   // Just good practice
         } else {
           throw;
@@ -158,13 +229,22 @@ namespace assetserver {
       } catch (curlWrapper::permanentTangFailure& exc) {
         // Permanent error, just rethrow to higher up
         throw;
+      } catch (curlWrapper::circuitOpen& exc) {
+        // The server is down, awaitCircuit() does the waiting (the slot, if any, was released on the way)
+        if (std::chrono::steady_clock::now() > giveUpTime) {
+          throw  unavailable("Waited too long for Tang access, we give up");
+        }
       } catch (std::exception& exc) {
         // Other errors are temporary. Authorization may come later so we retry in a little while, unless
         // we need to give up!!
         if (std::chrono::steady_clock::now() > giveUpTime) {
           throw  unavailable("Waited too long for Tang access, we give up");
         }
-        std::this_thread::sleep_for (requestInterval);
+        timeline->retry();
+        ++retries;
+        LATCHY_PROBE3(tang__retry, filePath.c_str(), retries, std::chrono::duration_cast<std::chrono::milliseconds>(requestInterval).count());
+        metrics::span             backingOff(timeline, metrics::stage::retryWait);
+        curlWrapper::backOff(extractedUrl, requestInterval);     // Back right away when the server recovers
         requestInterval = 10s;
       }
     }
@@ -174,6 +254,7 @@ namespace assetserver {
     DEBUG() << "Recovering key from server: " << joseLibWrapper::prettyPrintJson(recoveringKey_pub) << std::endl;
 
 
+    metrics::span                 unwrapping(timeline, metrics::stage::keyGeneration);
     joseLibWrapper::removePrivate(recoveringKey_pub);
     unwrappingJWK_j = joseLibWrapper::keyExchange(recoveringKey_pub, exchangedKey2_pub, true);
     //Probably not a good idea to show this, even for debug
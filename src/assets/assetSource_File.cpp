@@ -15,16 +15,26 @@
  */
 #include "assetSource.h"
 
+#include <cstring>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+
 namespace assetserver {
 
-  assetFile::assetFile(const std::string& f): filePath(f) {
+  assetFile::assetFile(const std::string& f, bool readyOnOpen): filePath(f) {
+    timeline->label(filePath.empty() ? "stdin" : filePath.string());
+
     // Verify that the file exists and that we can open it. We are reading from it!
     if (filePath.empty() == false) {
       useCin = false;
 
       if ( (std::filesystem::exists(filePath) == true) and ( (std::filesystem::is_regular_file(filePath) == true) or (std::filesystem::is_fifo(filePath) == true) ) ) {
-        inputStream.open(filePath.string(), std::ios::binary | std::ios::in);
-        if (inputStream.is_open() == false) {
+        // Non blocking, a named pipe without a writer yet must not hold us (and every secret after this one)
+        inputDescriptor = open(filePath.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        if (inputDescriptor < 0) {
           throw  unavailable(filePath.string() + " can't be open, check permissions");
         }
       } else {
@@ -34,22 +44,50 @@ namespace assetserver {
       // stdin case
       useCin = true;
     }
+
+    // The content is available as soon as we can read it
+    if (readyOnOpen == true) {
+      notifyReady();
+    }
+  }
+
+  assetFile::assetFile(const inMemory& m, bool readyOnOpen): useCin(false), buffer(m.content) {
+    // Nothing to open, the content is already here. getAsset() won't read anything since the buffer is not empty
+    if (readyOnOpen == true) {
+      notifyReady();
+    }
+  }
+
+  assetFile::~assetFile() {
+    if (inputDescriptor >= 0) {
+      close(inputDescriptor);
+    }
   }
 
   const std::string& assetFile::getAsset() {
 
     // Read the file, but only once (until destroyed)
-    std::stringstream               rdbuffer;
-
     if (buffer.empty() == true) {
-      if (useCin == true) {
-        std::cin.exceptions(std::ios::failbit | std::ios::badbit);      // No exception on eof
-        std::cin >> rdbuffer.rdbuf();     // Until eof
-      } else {
-        inputStream.exceptions(std::ios::failbit | std::ios::badbit);   // No exception on eof
+      metrics::span                 reading(timeline, metrics::stage::readInput);
+      readInput();
+    }
 
-        inputStream >> rdbuffer.rdbuf();  // Until eof
+    // There may or may not be trailing '\n', remote them!!
+    while (buffer.empty() == false) {
+      if (buffer.back() == '\n') {
+        buffer.pop_back();
+      } else {
+        break;
       }
+    }
+    return buffer;
+  }
+
+  void assetFile::readInput() {
+    if (useCin == true) {
+      std::stringstream             rdbuffer;
+      std::cin.exceptions(std::ios::failbit | std::ios::badbit);      // No exception on eof
+      std::cin >> rdbuffer.rdbuf();     // Until eof
       buffer = std::move(rdbuffer.str());
 
       // Clear the memory content.
@@ -57,17 +95,37 @@ namespace assetserver {
       for (std::size_t i = 0; i < buffer.size(); ++i) {
         rdbuffer << 0;    // Overwrite
       }
+      return;
     }
 
-    // There may or may not be trailing '\n', remote them!!
-    while (buffer.empty() == false) {
-      if (buffer.back() == '\n') {
-        buffer.pop_back();
-      } else {
+    // A regular file is always readable. A named pipe only polls readable (or hung up) once a writer came, which
+    // is what makes the 0 returned by read() a real EOF
+    std::string                     content;
+    char                            chunk[4096];
+    while (true) {
+      struct pollfd                 ready = { inputDescriptor, POLLIN, 0 };
+      int                           retval = poll(&ready, 1, 250);    // Bounded, so that a cancellation is noticed
+      if (isCancelled == true) {
+        throw unavailable(filePath.string() + " - Cancelled while waiting for the input");
+      }
+      if ( (retval == 0) or ( (retval < 0) and (errno == EINTR) ) ) {
+        continue;
+      }
+      if (retval < 0) {
+        throw unavailable(filePath.string() + " - Can not poll - " + strerror(errno));
+      }
+
+      ssize_t                       n = read(inputDescriptor, chunk, sizeof(chunk));
+      if (n > 0) {
+        content.append(chunk, n);
+      } else if (n == 0) {
         break;
+      } else if ( (errno != EAGAIN) and (errno != EWOULDBLOCK) and (errno != EINTR) ) {
+        throw unavailable(filePath.string() + " - Can not read - " + strerror(errno));
       }
     }
-    return buffer;
+
+    buffer = std::move(content);
   }
 
   void assetFile::destroy() {
@@ -0,0 +1,47 @@
+/*
+ * Copyright 2024 NearEDGE, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "assetSource.h"
+
+namespace assetserver {
+
+  //
+  // A source shared among declarations with the same JWE. Each provider gets its own view, the group counts them
+  //
+
+  bool assetShared::group::join() {
+    std::lock_guard<std::mutex>     lock(access);
+    if (released == true) {
+      return false;
+    }
+    try {
+      source->waitReady(0s);      // A failed unsealing is not handed over, the newcomer gets to try again
+    } catch (std::exception& exc) {
+      return false;
+    }
+    ++users;
+    return true;
+  }
+
+  void assetShared::group::leave() {
+    std::lock_guard<std::mutex>     lock(access);
+    if ( (users != 0) and (--users == 0) ) {
+      DEBUG() << "Last user of a shared source is gone, destroying it" << std::endl;
+      source->destroy();
+      released = true;
+    }
+  }
+
+} // namespace assetserver
@@ -14,13 +14,22 @@
  * limitations under the License.
  */
 #include "assets.h"
+#include "tangScheduler.h"
 
+#include <array>
 #include <chrono>
+#include <thread>
+
+#include <botan/hash.h>
+#include <botan/hex.h>
+
+#include "helpers/fileAccess.h"
 namespace assets {
   using namespace std::chrono_literals;
 
   list::list(const secretCfgList_t& list, bool compatibleMode, bool dump) {
-    curlWrapper::globalInit();    // Tis is rquired once and it is Ok to call multiple time as a flag prevent redoing it.
+    curlWrapper::prepare();       // In the background, the first Tang request (or key generation) waits for it if needed
+    tangScheduler::configure(list);
 
     try {
       // We may have more than 1 item to process. Anyone of them may fail and trhow an exception.
@@ -32,8 +41,8 @@ namespace assets {
         startAll();
       }
 
-      if ( (dump == false) and (assets.size() != list.secrets().size()) ) {
-        DEBUG() << "Something is wrong, we only have " << assets.size() << " assets" << std::endl;
+      if ( (dump == false) and ((assets.size() + watchers.size()) != list.secrets().size()) ) {
+        DEBUG() << "Something is wrong, we only have " << assets.size() << " assets and " << watchers.size() << " watched directories" << std::endl;
         DEBUG() << configuration::convertMsgToJsonString(list);
         stopAll();
         throw invalid("Inconsistent configured / running asset number");
@@ -50,28 +59,156 @@ namespace assets {
 
   void list::processConfiguration(const secretCfgList_t& list, bool compatibleMode, bool dump) {
     // Walk the declaration list and set the assets. On failure we throw an exception.
-    for (const auto asset : list.secrets()) {
-      //
-      // Asset ingress, ie source
-      //
-      DEBUG() << "Creating an asset source" << std::endl;
-      assetSource_p        source = createSource(asset, !dump, compatibleMode);
+    // Exec in place ends latchy, it is only allowed when there is nothing else to serve
+    allowReplace = ( (list.secrets().size() == 1) and (list.secrets(0).imethod() != model::latchy::secretIngestionMethods::IDIRECTORY) );
+    for (const auto& asset : list.secrets()) {
+      addDeclaration(asset, compatibleMode, dump, false);
+    }
+    allowReplace = false;
+  }
+
+  void list::addDeclaration(const secretCfg_t& asset, bool compatibleMode, bool dump, bool start) {
+    if (asset.imethod() == model::latchy::secretIngestionMethods::IDIRECTORY) {
+      // Not a single asset but a source of assets. Those are built as files arrive
       if (dump == true) {
-        // We are simply asked to dump the JWE content and not actually perform the whole decryption operation
-        source->dumpInfo();
+        USERMSG() << "Nothing to dump for the watched directory " << asset.in() << std::endl;
       } else {
-        //
-        // Asset egress - ie output - But only if we are not asked to dump the source info (such as JWE content)
-        //
-        DEBUG() << "Creating a provider (to an external client) to deliver the asset" << std::endl;
-        asset_p            provider = createProvider(asset, source);
+        watch_p            watcher = std::make_unique<directoryWatch>(asset, [this, compatibleMode](const secretCfg_t& cfg) { return createProvider(cfg, createSource(cfg, true, compatibleMode)); });
+        if (start == true) {
+          watcher->start();
+        }
+        declarationKeys[watcher.get()] = configuration::declarationKey(asset);
+        if (asset.out().empty() == false) {
+          outputs[watcher.get()] = asset.out();
+        }
+        watchers.push_back(std::move(watcher));
+      }
+      return;
+    }
 
-        // Keep the provider. The source object is own by the provider.
-        assets.insert(std::move(provider));
+    //
+    // Asset ingress, ie source
+    //
+    DEBUG() << "Creating an asset source" << std::endl;
+    assetSource_p        source = createSource(asset, !dump, compatibleMode);
+    if (dump == true) {
+      // We are simply asked to dump the JWE content and not actually perform the whole decryption operation
+      source->dumpInfo();
+    } else {
+      //
+      // Asset egress - ie output - But only if we are not asked to dump the source info (such as JWE content)
+      //
+      DEBUG() << "Creating a provider (to an external client) to deliver the asset" << std::endl;
+      asset_p            provider = createProvider(asset, source);
+      if (start == true) {
+        provider->start();
+      }
+
+      // Keep the provider. The source object is own by the provider.
+      declarationKeys[provider.get()] = configuration::declarationKey(asset);
+      if (asset.out().empty() == false) {
+        outputs[provider.get()] = asset.out();
       }
+      assets.insert(std::move(provider));
     }
   }
 
+  void list::reload(const secretCfgList_t& list, bool compatibleMode) {
+    // Each new declaration claims one running asset built from an identical declaration. Unclaimed assets
+    // were withdrawn (or changed) and are stopped, unmatched declarations are new and are started. Assets
+    // that already completed are claimed as well so that they do not deliver again.
+    tangScheduler::configure(list);
+    std::map<std::string, std::list<const secretCfg_t*>>    wanted;
+    for (const auto& declaration : list.secrets()) {
+      wanted[configuration::declarationKey(declaration)].push_back(&declaration);
+    }
+
+    auto claim = [&](const void* item) {
+      auto               key = declarationKeys.find(item);
+      if (key == declarationKeys.end()) {
+        return true;      // Not from the configuration, nothing to say about it
+      }
+      auto               match = wanted.find(key->second);
+      if ( (match != wanted.end()) and (match->second.empty() == false) ) {
+        match->second.pop_front();
+        return true;
+      }
+      declarationKeys.erase(key);
+      return false;
+    };
+
+    std::map<std::string, std::shared_future<void>>   vacating;     // Output of a withdrawn asset -> its destruction
+    auto retire = [&](const void* item, std::shared_future<void> done) {
+      auto               output = outputs.find(item);
+      if (output != outputs.end()) {
+        vacating[output->second] = done;
+        outputs.erase(output);
+      }
+      retiring.push_back(done);
+    };
+
+    std::size_t          kept = assets.size() + watchers.size();
+    std::size_t          removed = 0;
+    for (assetList::iterator asset = assets.begin(); asset != assets.end();) {
+      if (claim(asset->get()) == true) {
+        ++asset;
+        continue;
+      }
+      (*asset)->cancel();
+      const void*        item = asset->get();
+      auto               node = assets.extract(asset++);
+      // The destruction may linger (see assetProvider::stop()), do not hold the others for it
+      retire(item, std::async(std::launch::async, [withdrawn = std::move(node.value())]() mutable { withdrawn.reset(); }).share());
+      ++removed;
+    }
+    for (watchList::iterator watcher = watchers.begin(); watcher != watchers.end();) {
+      if (claim(watcher->get()) == true) {
+        ++watcher;
+        continue;
+      }
+      retire(watcher->get(), std::async(std::launch::async, [withdrawn = std::move(*watcher)]() mutable { withdrawn->stop(); withdrawn.reset(); }).share());
+      watcher = watchers.erase(watcher);
+      ++removed;
+    }
+    kept -= removed;
+
+    std::size_t          added = 0;
+    for (const auto& [key, declarations] : wanted) {
+      for (const auto declaration : declarations) {
+        try {
+          // A changed declaration often keeps its output. The withdrawn asset unlinks (or closes) it when it
+          // goes away, it must be gone before its replacement creates it again
+          auto           previous = vacating.find(declaration->out());
+          if (previous != vacating.end()) {
+            DEBUG() << "Waiting for the previous asset to release " << previous->first << std::endl;
+            previous->second.wait();
+          }
+          addDeclaration(*declaration, compatibleMode, false, true);
+          ++added;
+        } catch (std::exception& exc) {
+          // One bad declaration must not take the others down
+          USERMSG() << "Failed to start a new declaration - " << exc.what() << std::endl;
+        }
+      }
+    }
+
+    retiring.remove_if([](std::shared_future<void>& f) { return f.wait_for(0s) == std::future_status::ready; });
+    USERMSG() << "Configuration reloaded - " << kept << " kept, " << removed << " stopped and " << added << " started" << std::endl;
+  }
+
+  bool list::isComplete(std::chrono::milliseconds waitFor) const {
+    if (watchers.empty() == false) {
+      std::this_thread::sleep_for(waitFor);
+      return false;
+    }
+    for (const auto& asset : assets) {
+      if (asset->wait(waitFor) != std::future_status::ready) {
+        return false;
+      }
+    }
+    return true;
+  }
+
   void list::startAll() {
     DEBUG() << "We are about to start assets in the asset list. We have " << assets.size() << " asset definition in the list" << std::endl;
     try {
@@ -79,6 +216,9 @@ namespace assets {
       for (auto& asset : assets) {
         asset->start();
       }
+      for (auto& watcher : watchers) {
+        watcher->start();
+      }
     } catch (std::exception& exc) {
       std::cout << "Abnormal exception when starting the assets - " <<  exc.what() << std::endl;
     }
@@ -88,10 +228,12 @@ namespace assets {
     try {
       // Loop on all assets and check if they complete. If so, destroy then (i.e remove them from the list)
       DEBUG() << "We are about to stop assets in the asset list. We have " << assets.size() << " asset definition in the list" << std::endl;
-      while (assets.size() != 0) {
+      while ( (assets.size() != 0) or (watchers.size() != 0) ) {
         for (assetList::iterator asset = assets.begin(); asset != assets.end();) {
           if (*asset != nullptr) {
             if ((*asset)->wait(100ms) == std::future_status::ready) {
+              declarationKeys.erase(asset->get());
+              outputs.erase(asset->get());
               (*asset)->get();    // So that exceptions are handled here.
               asset = assets.erase(asset);
             } else {
@@ -99,15 +241,68 @@ namespace assets {
             }
           }
         }
+
+        // A watched directory only completes when it is stopped (or fails)
+        for (watchList::iterator watcher = watchers.begin(); watcher != watchers.end();) {
+          if ((*watcher)->wait(100ms) == std::future_status::ready) {
+            declarationKeys.erase(watcher->get());
+            outputs.erase(watcher->get());
+            (*watcher)->get();
+            watcher = watchers.erase(watcher);
+          } else {
+            ++watcher;
+          }
+        }
       }
 
       // The list is now empty
+      for (auto& withdrawn : retiring) {
+        withdrawn.wait();
+      }
+      retiring.clear();
 
     } catch (std::exception& exc) {
       USERMSG() << "Abnormal exception in one of the asset object - " <<  exc.what() << std::endl;
     }
   }
 
+  std::string list::contentKey(const secretCfg_t& cfg) const {
+    // Only a regular file can be read ahead, a named pipe or STDIN is consumed by reading it. The protected
+    // header and the ciphertext identify the secret, along with what changes the way it is unsealed
+    const std::string    unsealing = "/" + std::to_string(cfg.unseal()) + "/" + std::to_string(cfg.priority());
+    if ( (cfg.in().empty() == true) or (std::filesystem::is_regular_file(cfg.in()) == false) ) {
+      // The members of a bundle can still share such an input by its name, it is read once for all of them
+      return (cfg.member().empty() == false) ? "input:" + cfg.in() + unsealing : "";
+    }
+    try {
+      // Read, not mapped: a spool file may be rewritten while we hash it, a mapping would then be a SIGBUS. Not
+      // through a symbolic link, and never blocking should a named pipe have taken its place meanwhile
+      std::string                                 content;
+      if (helpers::fileAccess::readFile(cfg.in(), content, true, O_NOFOLLOW | O_NONBLOCK) != std::error_code()) {
+        return "";
+      }
+      std::string_view                            jwe = content;
+      std::array<std::string_view, 5>             parts;      // Compact serialization
+      std::size_t                                 count = 0;
+      for (std::size_t begin = 0; (begin <= jwe.size()) and (count < parts.size()); ++count) {
+        std::size_t                               end = std::min(jwe.find('.', begin), jwe.size());
+        parts[count] = jwe.substr(begin, end - begin);
+        begin = end + 1;
+      }
+      if ( (count != parts.size()) or (parts[0].empty() == true) or (parts[3].empty() == true) ) {
+        return "";      // Not for us to judge, the source will complain
+      }
+
+      std::unique_ptr<Botan::HashFunction>        sha = Botan::HashFunction::create_or_throw("SHA-256");
+      sha->update(reinterpret_cast<const uint8_t*>(parts[0].data()), parts[0].size());
+      sha->update(reinterpret_cast<const uint8_t*>("."), 1);
+      sha->update(reinterpret_cast<const uint8_t*>(parts[3].data()), parts[3].size());
+      return Botan::hex_encode(sha->final()) + unsealing;
+    } catch (std::exception& exc) {
+      return "";
+    }
+  }
+
   list::assetSource_p list::createSource(const secretCfg_t& cfg, bool autostart, bool compatibleMode) {
     //
     // Asset ingress, ie source
@@ -115,15 +310,39 @@ namespace assets {
 
     assetSource_p        source = nullptr;
 
+    // Only one member of a bundle may be wanted, out of a source which is then typically shared
+    auto                 selected = [&cfg](const assetSource_p& whole) -> assetSource_p {
+      if (cfg.member().empty() == true) {
+        return whole;
+      }
+      return std::make_shared<assetserver::assetMember>(whole, cfg.member());
+    };
+
+    // The same JWE may already be unsealing for another declaration
+    const std::string    digest = (autostart == true) ? contentKey(cfg) : "";
+    std::unique_lock<std::mutex>  lock(unsealingAccess, std::defer_lock);
+    if (digest.empty() == false) {
+      lock.lock();
+      std::erase_if(unsealing, [](const auto& item) { return item.second.expired(); });
+      auto               found = unsealing.find(digest);
+      if (found != unsealing.end()) {
+        auto             shared = found->second.lock();
+        if ( (shared != nullptr) and (shared->join() == true) ) {
+          INFO() << cfg.in() << " is the same secret as an earlier declaration, sharing its unsealing" << std::endl;
+          return selected(std::make_shared<assetserver::assetShared>(shared));
+        }
+      }
+    }
+
     if ( (cfg.lockingmethod() == model::latchy::secretLockingMethods::UNKNOWNLOCKING) or (cfg.lockingmethod() == model::latchy::secretLockingMethods::CLEVIS) ) {
       if (cfg.in().empty() == false) {
         // We assume that the input method is a file or a named pipe (the processing is the same)
         DEBUG() << "JWE source is file or named pipe" << std::endl;
-        source = std::make_shared<assetserver::assetFileClevis>(cfg.in(), metaData, autostart, compatibleMode);
+        source = std::make_shared<assetserver::assetFileClevis>(cfg.in(), metaData, autostart, compatibleMode, cfg.unseal(), cfg.priority());
       } else if ( (cfg.imethod() == model::latchy::secretIngestionMethods::STDIN) or (cfg.imethod() == model::latchy::secretIngestionMethods::UNKNOWNINGESTION)) {
         // Assume STDIN
         DEBUG() << "JWE source is STDIN" << std::endl;
-        source = std::make_shared<assetserver::assetFileClevis>("", metaData, autostart, compatibleMode);
+        source = std::make_shared<assetserver::assetFileClevis>("", metaData, autostart, compatibleMode, cfg.unseal(), cfg.priority());
       } else  if (cfg.imethod() == model::latchy::secretIngestionMethods::IENVVAR) {
         // Env var - Future
         throw unimplemented("Input asset from environment");
@@ -136,7 +355,13 @@ namespace assets {
       throw invalid("asset unlocking method");
     }
 
-    return source;
+    if (digest.empty() == false) {
+      auto               shared = std::make_shared<assetserver::assetShared::group>(source);
+      shared->join();
+      unsealing[digest] = shared;
+      return selected(std::make_shared<assetserver::assetShared>(shared));
+    }
+    return selected(source);
   }
 
   list::asset_p list::createProvider(const secretCfg_t& cfg, assetSource_p source) {
@@ -144,6 +369,12 @@ namespace assets {
     // Asset egress - ie output
     //
     asset_p     provider = nullptr;
+    if ( (cfg.unseal() != model::latchy::unsealPolicies::EAGER) and
+         (cfg.emethod() != model::latchy::secretEgressMethods::PIPE) and (cfg.emethod() != model::latchy::secretEgressMethods::SOCKET) ) {
+      // A file, stdout or a workload needs the secret up front, there is no client connecting to wait for
+      throw invalid("deferred unsealing requires a PIPE or SOCKET output");
+    }
+
     if ( (cfg.emethod() == model::latchy::secretEgressMethods::FILE) or (cfg.emethod() == model::latchy::secretEgressMethods::UNKNOWNEGRESS) ) {
       // File output method
       std::size_t     readCount = cfg.outcount();
@@ -160,7 +391,34 @@ namespace assets {
       if (cfg.out().empty() == true) {
         throw missingParameter("output pipename");
       }
-      provider = std::make_unique<assetserver::assetProvider>(source, cfg.out(), 0, true);
+      std::size_t     readCount = cfg.outcount();
+      if (readCount == 0) {
+        readCount = 1;
+      }
+      provider = std::make_unique<assetserver::assetProvider>(source, cfg.out(), readCount, true, std::chrono::seconds(cfg.ttl()));
+
+    } else if (cfg.emethod() == model::latchy::secretEgressMethods::SOCKET) {
+      // Sealed memfd handed over a Unix socket
+      std::size_t     readCount = cfg.outcount();
+      if (cfg.out().empty() == true) {
+        throw missingParameter("output socket name");
+      }
+      if (readCount == 0) {
+        readCount = 1;
+      }
+      provider = std::make_unique<assetserver::assetProviderSocket>(source, cfg.out(), readCount, std::chrono::seconds(cfg.ttl()));
+
+    } else if (cfg.emethod() == model::latchy::secretEgressMethods::EXEC) {
+      // Start the workload, the secret on one of its descriptors
+      if (cfg.command().empty() == true) {
+        throw missingParameter("command line");
+      }
+      if ( (cfg.replace() == true) and (allowReplace == false) ) {
+        // Other assets would be torn down without any cleanup by the exec
+        throw invalid("replace requires the EXEC declaration to be the only one");
+      }
+      os::launch::cmdLine_t   cmdline(cfg.command().begin(), cfg.command().end());
+      provider = std::make_unique<assetserver::assetProviderExec>(source, cmdline, (int) cfg.fd(), cfg.replace());
 
     } else if (cfg.emethod() == model::latchy::secretEgressMethods::STDOUT) {
       // STDOUT method
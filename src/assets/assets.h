@@ -17,10 +17,16 @@
 
 #include <string>
 #include <memory>
+#include <list>
+#include <map>
+#include <future>
+#include <chrono>
+#include <mutex>
 
 #include "curl.h"
 #include "assetProvider.h"
 #include "assetSource.h"
+#include "directoryWatch.h"
 
 namespace assets {
 
@@ -30,7 +36,8 @@ namespace assets {
   /// of may not include processing (such as unlocking the asset). The provider provides to the (external)
   /// client the asset and then signal the source to destroy it.
   ///
-  /// The list is built using a list of declarations.
+  /// The list is built using a list of declarations. It may later be reloaded with a new list, in which case
+  /// only the assets whose declaration changed are stopped or created. The others keep running untouched.
 
   class list {
   public:
@@ -42,6 +49,8 @@ namespace assets {
    
     using asset_p =             std::unique_ptr<assetserver::assetProviderBase<std::string>>;
     using assetList =           std::set<asset_p>;
+    using watch_p =             std::unique_ptr<directoryWatch>;
+    using watchList =           std::list<watch_p>;
 
   public:
     list() { };
@@ -51,10 +60,26 @@ namespace assets {
     void                        processConfiguration(const secretCfgList_t& list, bool compatibleMode, bool dump);
     void                        startAll();
     void                        stopAll();
+    void                        reload(const secretCfgList_t& list, bool compatibleMode);
+    bool                        isComplete(std::chrono::milliseconds waitFor) const;   // All assets completed (a watched directory never does)
   protected:
     assetList                   assets;
+    watchList                   watchers;           // Spool directories, each one producing assets as files arrive
     meta::composition           metaData;
 
+    std::map<const void*, std::string>  declarationKeys;    // Asset or watcher -> declaration it was built from
+    std::map<const void*, std::string>  outputs;            // Asset or watcher -> its "out", when it has one
+    std::list<std::shared_future<void>> retiring;           // Withdrawn assets, being destroyed
+
+    // Sources unsealing a given JWE, by content (see contentKey). Declarations of the same JWE share one source,
+    // hence a single Tang request. Watched directories add to it from their own thread
+    std::map<std::string, std::weak_ptr<assetserver::assetShared::group>>   unsealing;
+    std::mutex                          unsealingAccess;
+    std::string                         contentKey(const secretCfg_t& declaration) const;   // Empty when the JWE can not be read up front
+    bool                                allowReplace = false;   // Only while processing a configuration with a single declaration
+
+    void                        addDeclaration(const secretCfg_t& declaration, bool compatibleMode, bool dump, bool start);
+
     virtual assetSource_p       createSource(const secretCfg_t&, bool autostart, bool compatibleMode);
     virtual asset_p             createProvider(const secretCfg_t&, assetSource_p src);
 
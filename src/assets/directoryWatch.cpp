@@ -0,0 +1,245 @@
+/*
+ * Copyright 2024 NearEDGE, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "directoryWatch.h"
+#include "helpers/log.h"
+
+#include <vector>
+#include <algorithm>
+#include <cstring>
+
+#include <limits.h>
+#include <fnmatch.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/inotify.h>
+
+namespace assets {
+  using namespace std::chrono_literals;
+
+  directoryWatch::directoryWatch(const secretCfg_t& cfg, assetFactory_t factory): declaration(cfg), createAsset(factory), directory(cfg.in()) {
+    if (directory.empty() == true) {
+      throw error("", "Missing directory name");
+    }
+    if (std::filesystem::is_directory(directory) == false) {
+      throw error(directory.string(), "Not a directory");
+    }
+    if (cfg.pattern().empty() == false) {
+      pattern = cfg.pattern();
+    }
+    if (cfg.concurrency() != 0) {
+      concurrency = cfg.concurrency();
+    }
+
+    // Each dispatched asset reads a regular file
+    declaration.set_imethod(model::latchy::secretIngestionMethods::IFILE);
+  }
+
+  void directoryWatch::start() {
+    inotifyFD = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFD < 0) {
+      throw error(directory.string(), "Can not create the inotify object - " + std::string(strerror(errno)));
+    }
+
+    // IN_CLOSE_WRITE for files written in place, IN_MOVED_TO for files atomically renamed into the spool
+    if (inotify_add_watch(inotifyFD, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_ONLYDIR) < 0) {
+      std::string           reason(strerror(errno));
+      close(inotifyFD);
+      inotifyFD = -1;
+      throw error(directory.string(), "Can not watch - " + reason);
+    }
+
+    // Where processed files go. Being directories, they are neither watched nor matched
+    for (const auto& sub : { "done", "failed" }) {
+      std::error_code       ec;
+      std::filesystem::create_directory(directory / sub, ec);
+      if (ec) {
+        close(inotifyFD);
+        inotifyFD = -1;
+        throw error(directory.string(), "Can not create " + std::string(sub) + " - " + ec.message());
+      }
+    }
+
+    // Anything created before the watch was set
+    queueExisting();
+
+    USERMSG() << "Watching " << directory.string() << " for " << pattern << ", up to " << concurrency << " at once" << std::endl;
+    watchTask = std::async(std::launch::async, [&]() { watch(); });
+  }
+
+  void directoryWatch::stop() {
+    terminate = true;
+    if (watchTask.valid() == true) {
+      watchTask.wait();
+    }
+  }
+
+  std::string directoryWatch::expandTemplate(const std::string& outTemplate, const std::filesystem::path& input) {
+    std::string             retval(outTemplate);
+    const std::pair<std::string, std::string>   tokens[] = {
+      { "{name}", input.stem().string() },
+      { "{file}", input.filename().string() },
+    };
+
+    for (const auto& [token, value] : tokens) {
+      std::size_t           pos = 0;
+      while ( (pos = retval.find(token, pos)) != std::string::npos ) {
+        retval.replace(pos, token.size(), value);
+        pos += value.size();
+      }
+    }
+
+    return retval;
+  }
+
+  void directoryWatch::watch() {
+    try {
+      while (terminate == false) {
+        reap();
+        dispatch();
+
+        struct pollfd       ready = { inotifyFD, POLLIN, 0 };
+        int                 retval = poll(&ready, 1, 250);   // Also bounds how long a completed asset waits to be reaped
+        if ( (retval > 0) and (ready.revents & POLLIN) ) {
+          readEvents();
+        } else if ( (retval < 0) and (errno != EINTR) ) {
+          throw error(directory.string(), "Failed to poll the inotify object - " + std::string(strerror(errno)));
+        }
+      }
+    } catch (std::exception& exc) {
+      USERMSG() << "Stopping the watch of " << directory.string() << " - " << exc.what() << std::endl;
+    }
+
+    // Whatever was started is allowed to complete
+    inFlight.clear();
+    retiring.clear();
+    close(inotifyFD);
+    inotifyFD = -1;
+  }
+
+  void directoryWatch::queueExisting() {
+    std::vector<std::pair<std::filesystem::file_time_type, std::filesystem::path>>   existing;
+
+    for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+      std::error_code       ec;
+      if ( (entry.is_regular_file(ec) == true) and (isMatching(entry.path().filename().string()) == true) ) {
+        existing.emplace_back(entry.last_write_time(ec), entry.path());
+      }
+    }
+
+    std::sort(existing.begin(), existing.end());
+    for (const auto& [time, path] : existing) {
+      enqueue(path);
+    }
+  }
+
+  void directoryWatch::enqueue(const std::filesystem::path& input) {
+    // A file written while the watch was being set is both listed and reported, and a file may be closed
+    // several times. It is processed once
+    if (known.insert(input).second == true) {
+      pending.push_back(input);
+    } else {
+      DEBUG() << input.string() << " is already queued" << std::endl;
+    }
+  }
+
+  void directoryWatch::retire(const std::filesystem::path& input, bool delivered) {
+    std::error_code         ec;
+    std::filesystem::rename(input, directory / (delivered ? "done" : "failed") / input.filename(), ec);
+    if (ec) {
+      USERMSG() << "Can not move " << input.string() << " out of the spool - " << ec.message() << std::endl;
+    }
+    known.erase(input);
+  }
+
+  void directoryWatch::readEvents() {
+    alignas(struct inotify_event) char   buffer[10*(sizeof(struct inotify_event) + NAME_MAX + 1)];
+
+    while (true) {
+      ssize_t               retval = read(inotifyFD, buffer, sizeof(buffer));
+      if (retval <= 0) {
+        if ( (retval < 0) and (errno != EAGAIN) and (errno != EWOULDBLOCK) and (errno != EINTR) ) {
+          throw error(directory.string(), "Failed to read inotify events - " + std::string(strerror(errno)));
+        }
+        return;
+      }
+
+      // Events are delivered in the order they occurred, which is our arrival order
+      for (char* current = buffer; current < buffer + retval; ) {
+        struct inotify_event* event = reinterpret_cast<struct inotify_event*>(current);
+        if (event->mask & IN_Q_OVERFLOW) {
+          USERMSG() << "Too many events for " << directory.string() << ", some files may be missed" << std::endl;
+        } else if ( (event->len > 0) and ((event->mask & IN_ISDIR) == 0) and (isMatching(event->name) == true) ) {
+          DEBUG() << "New file " << event->name << " in " << directory.string() << std::endl;
+          enqueue(directory / event->name);
+        }
+        current += sizeof(struct inotify_event) + event->len;
+      }
+    }
+  }
+
+  void directoryWatch::dispatch() {
+    while ( (terminate == false) and (inFlight.size() < concurrency) and (pending.empty() == false) ) {
+      std::filesystem::path   input = pending.front();
+      pending.pop_front();
+
+      secretCfg_t             cfg(declaration);
+      cfg.set_in(input.string());
+      cfg.set_out(expandTemplate(declaration.out(), input));
+
+      try {
+        INFO() << "Processing " << input.string() << (cfg.out().empty() ? "" : " to " + cfg.out()) << std::endl;
+        asset_p               asset = createAsset(cfg);
+        asset->start();
+        inFlight.emplace_back(input, std::move(asset));
+      } catch (std::exception& exc) {
+        // One bad file must not stop the spool
+        USERMSG() << "Failed to process " << input.string() << " - " << exc.what() << std::endl;
+        retire(input, false);
+      }
+    }
+  }
+
+  void directoryWatch::reap() {
+    for (auto asset = inFlight.begin(); asset != inFlight.end();) {
+      auto& [input, provider] = *asset;
+      if (provider->wait(0s) == std::future_status::ready) {
+        bool                delivered = true;
+        try {
+          provider->get();
+        } catch (std::exception& exc) {
+          USERMSG() << "An asset from " << directory.string() << " failed - " << exc.what() << std::endl;
+          delivered = false;
+        }
+        retire(input, delivered);
+
+        // The destruction may linger (see assetProvider::stop()), do not hold the spool for it
+        retiring.push_back(std::async(std::launch::async, [completed = std::move(provider)]() mutable { completed.reset(); }));
+        asset = inFlight.erase(asset);
+      } else {
+        ++asset;
+      }
+    }
+
+    retiring.remove_if([](std::future<void>& f) { return f.wait_for(0s) == std::future_status::ready; });
+  }
+
+  bool directoryWatch::isMatching(const std::string& name) const {
+    // FNM_PERIOD so that hidden (usually temporary) files are left alone
+    return fnmatch(pattern.c_str(), name.c_str(), FNM_PERIOD) == 0;
+  }
+
+} // namespace assets
@@ -0,0 +1,94 @@
+/*
+ * Copyright 2024 NearEDGE, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <string>
+#include <deque>
+#include <list>
+#include <set>
+#include <memory>
+#include <future>
+#include <atomic>
+#include <functional>
+#include <filesystem>
+#include <stdexcept>
+
+#include "configuration.h"
+#include "assetProvider.h"
+
+namespace assets {
+
+  /// Spool directory ingestion
+  ///
+  /// Watch a directory (using inotify IN_CLOSE_WRITE and IN_MOVED_TO) and turn each new file matching the
+  /// pattern into an asset of its own. The asset is built by the owner (see assets::list) from a copy of
+  /// the declaration where the input is the new file and the output is expanded from the template.
+  ///
+  /// Files are dispatched in arrival order and no more than `concurrency` assets are in flight at once.
+  /// Files already present when the watch starts are processed first, oldest first. A file is queued once,
+  /// however many events report it, until it is processed. It is then moved to the done/ subdirectory when
+  /// its asset completed, or to failed/ otherwise, so that it is not processed again on the next start.
+  class directoryWatch {
+  public:
+    using secretCfg_t =         configuration::secretCfg_t;
+    using asset_p =             std::unique_ptr<assetserver::assetProviderBase<std::string>>;
+    using assetFactory_t =      std::function<asset_p(const secretCfg_t&)>;
+
+  public:
+    directoryWatch(const secretCfg_t& cfg, assetFactory_t factory);
+    virtual ~directoryWatch() { stop(); };
+
+    void                        start();
+    void                        stop();
+    std::future_status          wait(const std::chrono::nanoseconds duration = std::chrono::seconds(0)) const { if (watchTask.valid() == true) { return watchTask.wait_for(duration); } return std::future_status::ready; };
+    void                        get() { if (watchTask.valid() == true) { watchTask.get(); } };
+
+    static std::string          expandTemplate(const std::string& outTemplate, const std::filesystem::path& input);
+
+  protected:
+    secretCfg_t                 declaration;
+    assetFactory_t              createAsset;
+
+    std::filesystem::path       directory;
+    std::string                 pattern = "*.jwe";
+    std::size_t                 concurrency = 1;
+
+    std::future<void>           watchTask;
+    std::atomic<bool>           terminate = false;
+    int                         inotifyFD = -1;
+
+    std::deque<std::filesystem::path> pending;            // Arrival order
+    std::set<std::filesystem::path> known;                // Pending or in flight, a file is only queued once
+    std::list<std::pair<std::filesystem::path, asset_p>> inFlight;
+    std::list<std::future<void>> retiring;                // Completed assets being destroyed. Some providers linger in their destructor
+
+    void                        watch();
+    void                        queueExisting();
+    void                        enqueue(const std::filesystem::path& input);
+    void                        retire(const std::filesystem::path& input, bool delivered);   // Out of the spool, into done/ or failed/
+    void                        readEvents();
+    void                        dispatch();
+    void                        reap();
+    bool                        isMatching(const std::string& name) const;
+
+  public:
+    class error: public std::runtime_error {
+    public:
+      error(const std::string& dir, const std::string& msg = ""): runtime_error("Directory watch error for " + dir + ((msg.empty() == false) ? (" - " + msg) : "")) { };
+    };
+  };
+
+} // namespace assets
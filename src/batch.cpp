@@ -0,0 +1,111 @@
+/*
+ * Copyright 2024 NearEDGE, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "batch.h"
+#include "helpers/log.h"
+
+namespace batch {
+  using namespace std::chrono_literals;
+
+  processor::processor(std::size_t w, bool c): window((w == 0) ? 1 : w), compatibleMode(c), slots(window) {
+    curlWrapper::globalInit();
+  }
+
+  std::size_t processor::run(std::istream& input, std::ostream& output) {
+    std::list<std::future<void>>    inFlight;
+    std::string                     line;
+    std::size_t                     lineNumber = 0;
+
+    INFO() << "Batch processing with up to " << window << " records in flight" << std::endl;
+    while (std::getline(input, line)) {
+      ++lineNumber;
+      while ( (line.empty() == false) and ( (line.back() == '\r') or (line.back() == ' ') ) ) {
+        line.pop_back();
+      }
+      if (line.empty() == true) {
+        continue;
+      }
+
+      std::string                   id = std::to_string(lineNumber);
+      std::string                   jwe;
+      if (line.front() == '{') {
+        model::latchy::batchRecord  record;
+        std::string                 error;
+        if (configuration::parseJsonToMsg(line, record, &error) == false) {
+          model::latchy::batchResult   result;
+          result.set_id(id);
+          result.set_error("Invalid record - " + error);
+          ++failures;
+          emit(result, output);
+          continue;
+        }
+        if (record.id().empty() == false) {
+          id = record.id();
+        }
+        jwe = record.jwe();
+      } else {
+        jwe = std::move(line);
+      }
+      line.assign(line.size(), (char) 0);
+
+      // Wait for room in the window, then let the record go on its own
+      slots.acquire();
+      inFlight.push_back(std::async(std::launch::async, [this, id, jwe = std::move(jwe), &output]() mutable { unseal(id, jwe, output); }));
+      inFlight.remove_if([](std::future<void>& f) { return f.wait_for(0s) == std::future_status::ready; });
+    }
+
+    for (auto& record : inFlight) {
+      record.wait();
+    }
+
+    INFO() << "Batch complete, " << lineNumber << " lines and " << failures << " failures" << std::endl;
+    return failures;
+  }
+
+  void processor::unseal(const std::string& id, std::string& jwe, std::ostream& output) {
+    model::latchy::batchResult      result;
+    result.set_id(id);
+
+    try {
+      assetSource_p                 source = std::make_shared<assetserver::assetFileClevis>(assetserver::inMemory{jwe}, metaData, true, compatibleMode);
+      source->timing()->label("batch record " + id);
+      jwe.assign(jwe.size(), (char) 0);
+
+      while (source->waitReady(1s) == false) {}
+      result.set_secret(source->getAsset());
+      source->destroy();
+    } catch (std::exception& exc) {
+      jwe.assign(jwe.size(), (char) 0);
+      result.set_error(exc.what());
+      ++failures;
+    }
+
+    emit(result, output);
+    result.mutable_secret()->assign(result.secret().size(), (char) 0);
+    slots.release();
+  }
+
+  void processor::emit(const model::latchy::batchResult& result, std::ostream& output) {
+    std::string                     line = configuration::convertMsgToJsonString(result);
+
+    {
+      std::scoped_lock              lock(outputMutex);
+      output << line << '\n';
+      output.flush();
+    }
+    line.assign(line.size(), (char) 0);
+  }
+
+} // namespace batch
@@ -0,0 +1,57 @@
+/*
+ * Copyright 2024 NearEDGE, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <string>
+#include <list>
+#include <mutex>
+#include <atomic>
+#include <future>
+#include <semaphore>
+#include <iostream>
+
+#include "assets.h"
+
+namespace batch {
+
+  /// Bulk decryption over newline delimited JSON
+  ///
+  /// Each line of the input is either a compact JWE or a batchRecord ({"id": ..., "jwe": ...}). A raw JWE is
+  /// identified by its line number. Up to `window` records are unsealed concurrently and each result is
+  /// written as a batchResult line as soon as it completes. Results are tagged with their id since they
+  /// come out in completion order, not input order.
+  ///
+  /// All records share the same metadata snapshot and libcurl connection cache.
+  class processor: public assets::list {
+  public:
+    processor(std::size_t window, bool compatibleMode = false);
+    virtual ~processor() { };
+
+    std::size_t                 run(std::istream& input, std::ostream& output);   // Returns the number of failed records
+
+  protected:
+    std::size_t                 window;
+    bool                        compatibleMode = false;
+
+    std::counting_semaphore<>   slots;                    // Bounds the number of records in flight
+    std::mutex                  outputMutex;
+    std::atomic<std::size_t>    failures = 0;
+
+    void                        unseal(const std::string& id, std::string& jwe, std::ostream& output);
+    void                        emit(const model::latchy::batchResult& result, std::ostream& output);
+  };
+
+} // namespace batch
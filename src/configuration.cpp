@@ -17,9 +17,20 @@
 #include "helpers/log.h"
 
 #include <sstream>
+#include <memory>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <botan/hash.h>
+#include <botan/hex.h>
 
 #include <google/protobuf/util/message_differencer.h>
 #include <google/protobuf/util/json_util.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+#include <google/protobuf/io/coded_stream.h>
 namespace configuration {
 
   const std::string prettyPrintJson(const std::string& json) {
@@ -53,6 +64,25 @@ namespace configuration {
      return retval;
   }
 
+  secretCfgList_t parseNormalizedJson(std::string_view inputConfiguration) {
+    // The configuration is already in the {"secrets": [...]} form
+    google::protobuf::util::JsonParseOptions      jsonOpts;
+    model::latchy::secretList                     message;
+
+    jsonOpts.ignore_unknown_fields = true;
+    jsonOpts.case_insensitive_enum_parsing = false;
+
+    absl::Status  result = google::protobuf::util::JsonStringToMessage(inputConfiguration, (google::protobuf::Message*) &message, jsonOpts);
+    if (result.ok() == true) {
+      return message;
+    }
+
+    USERMSG() << "Failed to parse the configuration JSON, we bail out - " << result.message() << std::endl;
+    DEBUG() << "Configuration string was - " << inputConfiguration << std::endl;
+
+    throw std::runtime_error("Failed to parse a JSON string into a protobuf Message");
+  }
+
   secretCfgList_t parseStringToMsg(std::string& inputConfiguration) {
     // The provided configuration string may not be a valid protoBuf message. A message is
     // ALWAYS a JSON object. But since the configuration is actually an object with a single element,
@@ -84,22 +114,45 @@ namespace configuration {
     }
     LOGTOFILE(std::string("Configuration string: ") + inputConfiguration + "\n");  
 
-    // Now, the actual protobuf handling
-    google::protobuf::util::JsonParseOptions      jsonOpts;
-    model::latchy::secretList                     message;
+    return parseNormalizedJson(inputConfiguration);
+  }
 
-    jsonOpts.ignore_unknown_fields = true;
-    jsonOpts.case_insensitive_enum_parsing = false;
+  secretCfgList_t implicitList() {
+    // Same as {"secrets":[{"iMethod":"STDIN", "lockingMethod":"CLEVIS", "eMethod":"STDOUT"}]}, without paying for
+    // the JSON parser (and the type resolver it builds on first use) in the mode meant for quick one-off calls
+    secretCfgList_t                               message;
+    secretCfg_t*                                  declaration = message.add_secrets();
+    declaration->set_imethod(model::latchy::secretIngestionMethods::STDIN);
+    declaration->set_lockingmethod(model::latchy::secretLockingMethods::CLEVIS);
+    declaration->set_emethod(model::latchy::secretEgressMethods::STDOUT);
+    return message;
+  }
 
-    absl::Status  result = google::protobuf::util::JsonStringToMessage(inputConfiguration, (google::protobuf::Message*) &message, jsonOpts);
-    if (result.ok() == true) {
+  secretCfg_t parseStringToDeclaration(const std::string& inputDeclaration) {
+    // A single secret declaration, as a JSON object. This is used when requests come one at a time (such as
+    // with the agent) instead of a complete list.
+    secretCfg_t                                   message;
+    std::string                                   error;
+
+    if (parseJsonToMsg(inputDeclaration, message, &error) == true) {
       return message;
     }
 
-    USERMSG() << "Failed to parse the configuration JSON, we bail out - " << result.message() << std::endl;
-    DEBUG() << "Configuration string was - " << inputConfiguration << std::endl;
+    DEBUG() << "Failed to parse the secret declaration - " << error << std::endl;
+    throw std::runtime_error("Failed to parse a JSON string into a secret declaration");
+  }
 
-    throw std::runtime_error("Failed to parse a JSON string into a protobuf Message");
+  bool parseJsonToMsg(const std::string& json, google::protobuf::Message& m, std::string* error) {
+    google::protobuf::util::JsonParseOptions      jsonOpts;
+
+    jsonOpts.ignore_unknown_fields = true;
+    jsonOpts.case_insensitive_enum_parsing = false;
+
+    absl::Status  result = google::protobuf::util::JsonStringToMessage(json, &m, jsonOpts);
+    if ( (result.ok() == false) and (error != nullptr) ) {
+      *error = std::string(result.message());
+    }
+    return result.ok();
   }
 
   void printSecret(const secretCfg_t& secret) {
@@ -117,4 +170,117 @@ namespace configuration {
     std::cout << "   Read count " << secret.outcount() << std::endl;
 
   }
+  std::string declarationKey(const secretCfg_t& declaration) {
+    // The deterministic wire format, so that a configuration can be compared to the previous one with a
+    // lookup instead of a MessageDifferencer pass per pair of declarations
+    std::string                                   key;
+    {
+      google::protobuf::io::StringOutputStream    stream(&key);
+      google::protobuf::io::CodedOutputStream     coded(&stream);
+      coded.SetSerializationDeterministic(true);
+      declaration.SerializeToCodedStream(&coded);
+    }
+    return key;
+  }
+
+  constexpr uint32_t    cacheFormat = 3;       // 2: Tang limits and priorities, 3: bundle members
+
+  namespace {
+    // The cache is only trusted when nobody but us could have written it: ours, not writable by the group or
+    // the others, and not a symbolic link. Checked on the very descriptor it is read from
+    bool readTrustedCache(const std::filesystem::path& cacheFile, std::string& content) {
+      int                                         descriptor = open(cacheFile.c_str(), O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+      if (descriptor < 0) {
+        DEBUG() << "No cached configuration " << cacheFile.string() << " - " << strerror(errno) << std::endl;
+        return false;
+      }
+      struct stat                                 status;
+      if ( (fstat(descriptor, &status) != 0) or (S_ISREG(status.st_mode) == false) or (status.st_uid != geteuid()) or ((status.st_mode & (S_IWGRP | S_IWOTH)) != 0) ) {
+        USERMSG() << "Ignoring the cached configuration " << cacheFile.string() << ", it must be a file of ours that only we can write" << std::endl;
+        close(descriptor);
+        return false;
+      }
+
+      char                                        chunk[16384];
+      ssize_t                                     got;
+      while ( ((got = read(descriptor, chunk, sizeof(chunk))) > 0) or ((got < 0) and (errno == EINTR)) ) {
+        if (got > 0) {
+          content.append(chunk, got);
+        }
+      }
+      close(descriptor);
+      return (got == 0);
+    }
+  }
+
+  secretCfgList_t parseFileToMsg(const std::filesystem::path& file, bool useCache) {
+    // Read rather than mapped. Configuration files are reloaded while in use, one truncated under a mapping
+    // would be a SIGBUS
+    std::string                                   content;
+    std::error_code                               failed = helpers::fileAccess::readFile(file, content, true);
+    if (failed == std::errc::no_such_file_or_directory) {
+      throw helpers::fileAccess::fileNotFound(file);
+    } else if (failed != std::error_code()) {
+      throw helpers::fileAccess::canNotOpen(file, false);
+    }
+    std::filesystem::path                         cacheFile(file.string() + ".cache");
+    std::string                                   hash;
+
+    if (useCache == true) {
+      std::unique_ptr<Botan::HashFunction>        sha = Botan::HashFunction::create_or_throw("SHA-256");
+      sha->update(reinterpret_cast<const uint8_t*>(content.data()), content.size());
+      hash = Botan::hex_encode(sha->final());
+
+      std::string                                 cached;
+      if (readTrustedCache(cacheFile, cached) == true) {
+        model::latchy::secretListCache            cache;
+        if ( (cache.ParseFromString(cached) == true) and (cache.format() == cacheFormat) and (cache.sourcehash() == hash) ) {
+          DEBUG() << "Using the cached configuration " << cacheFile.string() << std::endl;
+          return std::move(*cache.mutable_list());
+        }
+        INFO() << "The cached configuration " << cacheFile.string() << " is stale" << std::endl;
+      }
+    }
+
+    std::string_view                              json = content;
+    std::size_t                                   firstBrace = json.find('{');
+    std::size_t                                   firstSquarebracket = json.find('[');
+    secretCfgList_t                               retval;
+    if ( (firstSquarebracket != std::string_view::npos) and (firstBrace < firstSquarebracket) ) {
+      retval = parseNormalizedJson(json);
+    } else {
+      std::string                                 adjusted(json);
+      retval = parseStringToMsg(adjusted);
+    }
+
+    if (useCache == true) {
+      // Written aside and renamed, a reader never sees half of it. Failing to cache is not an error
+      model::latchy::secretListCache              cache;
+      cache.set_format(cacheFormat);
+      cache.set_sourcehash(hash);
+      *cache.mutable_list() = retval;
+
+      std::filesystem::path                       pending(cacheFile.string() + "." + std::to_string(getpid()));
+      int                                         descriptor = open(pending.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600);
+      if ( (descriptor >= 0) and (cache.SerializeToFileDescriptor(descriptor) == true) and (close(descriptor) == 0) ) {
+        descriptor = -1;
+        std::error_code                           ec;
+        std::filesystem::rename(pending, cacheFile, ec);
+        if (ec) {
+          DEBUG() << "Can not write the cached configuration " << cacheFile.string() << " - " << ec.message() << std::endl;
+          std::filesystem::remove(pending, ec);
+        }
+      } else {
+        DEBUG() << "Can not write the cached configuration " << pending.string() << " - " << strerror(errno) << std::endl;
+        if (descriptor >= 0) {
+          close(descriptor);
+        }
+        std::error_code                           ec;
+        std::filesystem::remove(pending, ec);
+      }
+    }
+
+    return retval;
+  }
+
 } // namespace configuration
@@ -16,6 +16,8 @@
 #pragma once
 
 #include <string>
+#include <string_view>
+#include <filesystem>
 
 #include "latchyConfiguration.pb.h"
 
@@ -32,5 +34,10 @@ namespace configuration {
   using secretCfgList_t =           model::latchy::secretList;
 
   secretCfgList_t                   parseStringToMsg(std::string& inputConfiguration);
+  secretCfgList_t                   parseFileToMsg(const std::filesystem::path& file, bool useCache = false);   // The cache sits next to the file, as FILE.cache
+  secretCfgList_t                   implicitList();                 // STDIN to STDOUT, a single clevis JWE
+  secretCfg_t                       parseStringToDeclaration(const std::string& inputDeclaration);
+  bool                              parseJsonToMsg(const std::string& json, google::protobuf::Message& m, std::string* error = nullptr);
+  std::string                       declarationKey(const secretCfg_t& declaration);    // Identical declarations, identical keys
 } // namespace configuration
 
@@ -15,6 +15,11 @@
  * limitations under the License.
  */
 #include <cstring>
+#include <mutex>
+#include <future>
+#include <map>
+#include <chrono>
+#include <condition_variable>
 #include "curl.h"
 #include <curl/curl.h>      // From libcurl
 #include <openssl/crypto.h>
@@ -22,20 +27,64 @@
 #include "helpers/forkExec.h"
 #include "helpers/stringSplit.h"
 #include "helpers/log.h"
+#include "helpers/metrics.h"
+#include "helpers/probes.h"
 #include "helpers/fileAccess.h"
+#include "helpers/startup.h"
 
 namespace curlWrapper {
-  bool        isGlobalInit = false;
+  using namespace std::chrono_literals;
+
+  std::once_flag    isGlobalInit;
+  std::future<void> backgroundInit;     // See prepare()
+
+  // Shared DNS cache, TLS sessions and connections across all easy handles. With many assets (or a
+  // long running agent) talking to the same tang servers this saves a handshake per request.
+  CURLSH*     sharedState = nullptr;
+  std::mutex  sharedStateMutex[CURL_LOCK_DATA_LAST];
+
+  void sharedLock(CURL* handle, curl_lock_data data, curl_lock_access access, void* userptr) {
+    sharedStateMutex[data].lock();
+  }
+
+  void sharedUnlock(CURL* handle, curl_lock_data data, void* userptr) {
+    sharedStateMutex[data].unlock();
+  }
+
+  void initialize() {
+    curl_global_init(CURL_GLOBAL_ALL);
+    OPENSSL_init_crypto(OPENSSL_INIT_NO_LOAD_CONFIG, nullptr);    // This is an attempt at avoiding the 1st on fedora. This prevents using /etc/ssl/openssl.cnf
+
+    sharedState = curl_share_init();
+    if (sharedState != nullptr) {
+      curl_share_setopt(sharedState, CURLSHOPT_LOCKFUNC, sharedLock);
+      curl_share_setopt(sharedState, CURLSHOPT_UNLOCKFUNC, sharedUnlock);
+      curl_share_setopt(sharedState, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+      curl_share_setopt(sharedState, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+      curl_share_setopt(sharedState, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+    }
+    startup::mark("libcurl and OpenSSL ready");
+  }
 
   void globalInit() {
-    if (isGlobalInit == false ) {
-      curl_global_init(CURL_GLOBAL_ALL);
-      OPENSSL_init_crypto(OPENSSL_INIT_NO_LOAD_CONFIG, nullptr);    // This is an attempt at avoiding the 1st on fedora. This prevents using /etc/ssl/openssl.cnf
-      isGlobalInit = true;
+    // Whoever comes while prepare() is at it waits for it
+    std::call_once(isGlobalInit, initialize);
+  }
+
+  void prepare() {
+    if (backgroundInit.valid() == false) {
+      backgroundInit = std::async(std::launch::async, globalInit);
     }
   }
 
   void globalCleanUp() {
+    if (backgroundInit.valid() == true) {
+      backgroundInit.wait();
+    }
+    if (sharedState != nullptr) {
+      curl_share_cleanup(sharedState);
+      sharedState = nullptr;
+    }
     curl_global_cleanup();
   }
   
@@ -71,9 +120,141 @@ namespace curlWrapper {
     return nullptr;
 }
 
+  //
+  // Circuit breaker, per Tang URL
+  //
+  namespace {
+    enum class circuitState { closed, open, halfOpen };
+
+    struct health {
+      circuitState                      state = circuitState::closed;
+      std::size_t                       failures = 0;           // In a row
+      std::size_t                       recoveries = 0;         // Times it closed again, for backOff
+      std::chrono::seconds              backOff = 1s;           // Between two probes
+      std::chrono::steady_clock::time_point   nextProbe;
+    };
+
+    constexpr std::size_t               failuresToOpen = 3;
+    constexpr std::chrono::seconds      maxBackOff = 30s;
+    constexpr std::chrono::seconds      maxCircuitWait = 60s;   // Then circuitOpen, so that the caller gets to check its own deadline
+
+    std::mutex                          circuitMutex;
+    std::condition_variable             circuitChanged;
+    std::map<std::string, health>       circuits;
+
+    const char* stateName(circuitState s) {
+      return (s == circuitState::closed) ? "closed" : ((s == circuitState::open) ? "open" : "half-open");
+    }
+
+    // True when a request may go out right now
+    bool mayGo(const health& server, std::chrono::steady_clock::time_point now) {
+      return (server.state == circuitState::closed) or ( (server.state == circuitState::open) and (now >= server.nextProbe) );
+    }
+
+    // Never waits, true when the request is the probe of an open circuit
+    bool admit(const std::string& url) {
+      std::lock_guard<std::mutex>       lock(circuitMutex);
+      health&                           server = circuits[url];
+      if (server.state == circuitState::closed) {
+        return false;
+      }
+      if (mayGo(server, std::chrono::steady_clock::now()) == false) {
+        throw circuitOpen(url);     // Another caller got the probe, back to awaitCircuit()
+      }
+      server.state = circuitState::halfOpen;
+      LATCHY_PROBE2(circuit__change, url.c_str(), static_cast<int>(server.state));
+      DEBUG() << "Probing " << url << std::endl;
+      return true;
+    }
+
+    void report(const std::string& url, bool answered, bool probe) {
+      std::lock_guard<std::mutex>       lock(circuitMutex);
+      health&                           server = circuits[url];
+      const circuitState                before = server.state;
+      if (answered == true) {
+        server.failures = 0;
+        server.backOff = 1s;
+        if (server.state != circuitState::closed) {
+          ++server.recoveries;
+        }
+        server.state = circuitState::closed;
+      } else {
+        ++server.failures;
+        if (probe == true) {
+          server.backOff = std::min(server.backOff * 2, maxBackOff);
+          server.state = circuitState::open;
+          server.nextProbe = std::chrono::steady_clock::now() + server.backOff;
+        } else if ( (server.state == circuitState::closed) and (server.failures >= failuresToOpen) ) {
+          server.state = circuitState::open;
+          server.nextProbe = std::chrono::steady_clock::now() + server.backOff;
+        }
+      }
+
+      if (server.state != before) {
+        LATCHY_PROBE2(circuit__change, url.c_str(), static_cast<int>(server.state));
+        if (server.state == circuitState::closed) {
+          USERMSG() << "Tang " << url << " answers again, releasing the waiting requests" << std::endl;
+        } else if (before == circuitState::closed) {
+          USERMSG() << "Tang " << url << " failed " << server.failures << " times in a row, only probing it until it comes back" << std::endl;
+        } else {
+          DEBUG() << "Tang " << url << " circuit " << stateName(before) << " -> " << stateName(server.state) << ", next probe in " << server.backOff.count() << "s" << std::endl;
+        }
+      }
+      circuitChanged.notify_all();
+    }
+
+    std::string exchangeWithTang(const std::string& url, const std::string& kid, const std::string& key, const std::string& queryString);
+  }
+
+  void awaitCircuit(const std::string& url, const std::atomic_bool& cancelled) {
+    std::unique_lock<std::mutex>        lock(circuitMutex);
+    health&                             server = circuits[url];
+    const auto                          giveUp = std::chrono::steady_clock::now() + maxCircuitWait;
+    while (true) {
+      const auto                        now = std::chrono::steady_clock::now();
+      if (mayGo(server, now) == true) {
+        return;
+      }
+      if ( (cancelled == true) or (now >= giveUp) ) {
+        throw circuitOpen(url);
+      }
+      // A probe in flight, or the next one not due yet
+      circuitChanged.wait_until(lock, std::min(now + 250ms, (server.state == circuitState::open) ? server.nextProbe : now + 250ms));
+    }
+  }
+
+  void backOff(const std::string& url, std::chrono::nanoseconds delay) {
+    std::unique_lock<std::mutex>        lock(circuitMutex);
+    health&                             server = circuits[url];
+    const std::size_t                   recoveries = server.recoveries;
+    circuitChanged.wait_for(lock, delay, [&server, recoveries]() { return server.recoveries != recoveries; });
+  }
+
   std::string keyRecoverViaTang(const std::string& url, const std::string& kid, const std::string& key, const std::string& queryString, const std::atomic_bool& cancelled ) {
     globalInit();
 
+    const bool            probe = admit(url);
+    try {
+      std::string         retval = exchangeWithTang(url, kid, key, queryString);
+      report(url, true, probe);
+      return retval;
+    } catch (unsuccessfulTangAnswer& exc) {
+      report(url, true, probe);     // Not authorized yet, or failing, but the server is up
+      throw;
+    } catch (failedTangInteraction& exc) {
+      report(url, false, probe);
+      throw;
+    } catch (curlException& exc) {
+      report(url, true, probe);     // Refused, but the server is up
+      throw;
+    } catch (...) {
+      report(url, false, probe);
+      throw;
+    }
+  }
+
+  namespace {
+  std::string exchangeWithTang(const std::string& url, const std::string& kid, const std::string& key, const std::string& queryString) {
     CURL*                 curlSession = curl_easy_init();
     std::string           completeUrl(url +"/rec/" + kid + (queryString.empty() ? "" : std::string("?") + queryString));
     struct curl_slist*    headerList = nullptr;
@@ -99,6 +280,9 @@ namespace curlWrapper {
       curl_easy_setopt(curlSession, CURLOPT_HEADER, 1);       // The response body will include the header. See the doc was a discussion about transfer size
       curl_easy_setopt(curlSession, CURLOPT_NOPROGRESS, 1);
       curl_easy_setopt(curlSession, CURLOPT_NOSIGNAL, 0);     // We allow CURL to use signals. We may need to adjust this later (but see the doc regarding DNS)
+      if (sharedState != nullptr) {
+        curl_easy_setopt(curlSession, CURLOPT_SHARE, sharedState);
+      }
 
       // Callback related
       curl_easy_setopt(curlSession, CURLOPT_WRITEFUNCTION, write_callback);
@@ -116,11 +300,16 @@ namespace curlWrapper {
       char                error_buffer[CURL_ERROR_SIZE];
       curl_easy_setopt(curlSession, CURLOPT_ERRORBUFFER, error_buffer);
 
+      LATCHY_PROBE2(tang__start, url.c_str(), key.size());
+      startup::mark("first Tang request");
+      startup::report();
       result = curl_easy_perform(curlSession);
 
       curl_easy_cleanup(curlSession);
 
       if (result != CURLcode::CURLE_OK) {
+        metrics::tangResponse(url, "none");
+        LATCHY_PROBE3(tang__done, url.c_str(), 0, 0);
         INFO() << "Curl reported an error - " << curl_easy_strerror(result) << std::endl;
         if (strlen(error_buffer) != 0) {
           DEBUG() << "Curl detailed error - " << error_buffer << std::endl;
@@ -179,6 +368,8 @@ namespace curlWrapper {
 
         if (foundHeaderEnd &&  responseLine.empty() == false) {
           std::deque<std::string>    decomposed = misc::split(responseLine, ' ');
+          metrics::tangResponse(url, (decomposed.size() >= 2) ? decomposed[1] : "invalid");
+          LATCHY_PROBE3(tang__done, url.c_str(), (decomposed.size() >= 2) ? atoi(decomposed[1].c_str()) : -1, (long) ss.tellp());
           if (decomposed.size() >= 2) {
             if (decomposed[1] == "200") {
               std::ostringstream content;
@@ -197,7 +388,13 @@ namespace curlWrapper {
               // The server will NEVER respond positively
               throw permanentTangFailure(url + "-" + ss.str().substr(contentPosition));
             }
+
+            // Any other status, the server is there but does not give the key (yet)
+            throw unsuccessfulTangAnswer(url + " - HTTP " + decomposed[1]);
           }
+        } else {
+          metrics::tangResponse(url, "invalid");
+          LATCHY_PROBE3(tang__done, url.c_str(), -1, (long) ss.tellp());
         }
 
         throw failedTangInteraction(url);
@@ -206,4 +403,6 @@ namespace curlWrapper {
     throw failedTangInteraction(url);
   }
 
-}
+  } // namespace
+
+} // namespace curlWrapper
@@ -18,12 +18,24 @@
 #include <string>
 #include <stdexcept>
 #include <atomic>
+#include <chrono>
 
 namespace curlWrapper {
   void globalInit();
+  void prepare();       // globalInit() in the background, a later globalInit() waits for it
   void globalCleanUp();
 
+  /// Every request goes through a circuit breaker, per Tang URL. After a few consecutive requests without any HTTP
+  /// answer (no connection, timeout, garbled response) the circuit opens: a single probe request goes out now and
+  /// then (backing off up to 30s) while the others wait in awaitCircuit(), and they are all released as soon as a
+  /// request gets an answer. Any HTTP status, even a refusal or a 5xx (unsuccessfulTangAnswer), closes it.
+  /// keyRecoverViaTang itself never waits, it throws circuitOpen when the request may not go out.
   std::string                 keyRecoverViaTang(const std::string& url, const std::string& kid, const std::string& key, const std::string& queryString, const std::atomic_bool& cancelled );
+  /// Wait until a request to url may go out (circuit closed or probe due). Throws circuitOpen after a while, or
+  /// when cancelled. Call it before taking a tangScheduler slot, no slot is held while the server is down
+  void                        awaitCircuit(const std::string& url, const std::atomic_bool& cancelled);
+  /// Sleep before retrying url, cut short when its circuit closes again
+  void                        backOff(const std::string& url, std::chrono::nanoseconds delay);
 
   // Exception classes, including an overall base exception class
   class curlException: public std::runtime_error {
@@ -37,6 +49,19 @@ namespace curlWrapper {
     failedTangInteraction(const std::string& msg = ""): curlException ("Error communicating with tang " + ((msg.empty() == false) ? (" - " + msg) : "")) { };
   };
 
+  // The server answered, but not with the key (403 not authorized yet, 5xx, ...). Temporary as well, but it
+  // tells that the server is up, as far as the circuit breaker goes
+  class unsuccessfulTangAnswer: public failedTangInteraction {
+  public:
+    unsuccessfulTangAnswer(const std::string& msg = ""): failedTangInteraction ("Unsuccessful answer " + ((msg.empty() == false) ? (" - " + msg) : "")) { };
+  };
+
+  // The circuit of the server is open (see keyRecoverViaTang), no request was made
+  class circuitOpen: public failedTangInteraction {
+  public:
+    circuitOpen(const std::string& msg = ""): failedTangInteraction ("Server is down, waiting for it to come back " + ((msg.empty() == false) ? (" - " + msg) : "")) { };
+  };
+
   class notFoundTangFailure: public curlException {
   public:
     notFoundTangFailure(const std::string& msg = ""): curlException ("Got a 404 from tang " + ((msg.empty() == false) ? (" - " + msg) : "")) { };
@@ -44,16 +44,32 @@ void showHelp() {
     << "\n" \
     << "\tlatchy --cfg '<JSON STRING>', or" << "\n" \
     << "\n" \
+    << "\tlatchy --cfg-file CONFIGURATION.json, or" << "\n" \
+    << "\n" \
     << "\texport LATCHYCFG='<JSON STRING>'; cat CIPHERTEXT.jwe | latchy"<< "\n" \
 
     << "\n" \
     << "Command line arguments" << "\n" \
+    << "\t\"--agent\"      - Stay resident and serve unlock requests on the given Unix socket path (see below)" << "\n" \
+    << "\t\"--batch\"      - Bulk mode, one compact JWE or {\"id\": ID, \"jwe\": JWE} per line of stdin. Results come" << "\n" \
+    << "\t                 out on stdout as {\"id\": ID, \"secret\": BASE64} or {\"id\": ID, \"error\": REASON} lines" << "\n" \
+    << "\t                 in completion order. A raw JWE is identified by its line number" << "\n" \
     << "\t\"--cfg\"        - JSON configuration string (see below for details)" << "\n" \
+    << "\t\"--cfg-file\"   - JSON configuration file. It is reloaded on SIGHUP or when it changes, only the secrets" << "\n" \
+    << "\t                 whose configuration changed are stopped or started" << "\n" \
+    << "\t\"--cfg-cache\"  - Keep the parsed --cfg-file next to it (as FILE.cache), later runs skip the JSON parsing" << "\n" \
+    << "\t                 while the file is unchanged" << "\n" \
     << "\t\"--compatible\" - Support TANG with strict API content" << "\n" \
     << "\t\"--debug\"      - Verbose debugging output (on stderr)" << "\n" \
     << "\t\"--dump\"       - Output the content of the protected header of the JWE and exit. Do not perform decryption" << "\n" \
     << "\t\"--help\"       - This help" << "\n" \
+    << "\t\"--metrics\"    - Export per secret stage latencies, Tang retries and responses to the given file at exit," << "\n" \
+    << "\t                 in the Prometheus text format (node exporter textfile collector), or JSON for a .json file" << "\n" \
+    << "\t\"--metrics-interval\" - Also export every given number of seconds (defaults to 60, 0 for only at exit)" << "\n" \
+    << "\t\"--startup-timing\" - Print how long each startup step took, up to the first Tang request (on stderr). The" << "\n" \
+    << "\t                 LATCHY_STARTUP_TIMING environment variable does the same, for the implicit mode" << "\n" \
     << "\t\"--trace\"      - Minimal information (on stderr)" << "\n" \
+    << "\t\"--window\"     - Number of records unsealed concurrently in batch mode (defaults to 16)" << "\n" \
 
     << "\n" \
     << "JSON configuration string. This is an array providing 1 or more configurations, each pertaining to a single" << "\n" \
@@ -76,13 +92,55 @@ void showHelp() {
     << "\n" \
     << "The actual configuration is " << "\n" \
     << "{" << "\n" \
-    << "\t\"iMethod\": \"STDIN\" | \"IFILE\" | \"IPIPE\", " << "\n" \
-    << "\t\"in\": FILENAME, " << "\n" \
-    << "\t\"eMethod\": \"STDOUT\" | \"FILE\" | \"PIPE\", " << "\n" \
+    << "\t\"iMethod\": \"STDIN\" | \"IFILE\" | \"IPIPE\" | \"IDIRECTORY\", " << "\n" \
+    << "\t\"in\": FILENAME | DIRECTORY, " << "\n" \
+    << "\t\"pattern\": GLOB, (IDIRECTORY only, defaults to *.jwe)" << "\n" \
+    << "\t\"concurrency\": INTEGER, (IDIRECTORY only, defaults to 1)" << "\n" \
+    << "\t\"eMethod\": \"STDOUT\" | \"FILE\" | \"PIPE\" | \"SOCKET\" | \"EXEC\", " << "\n" \
     << "\t\"out\": FILENAME, " << "\n" \
-    << "\t\"outCount\": INTEGER" << "\n" \
+    << "\t\"outCount\": INTEGER, (number of reads, successive readers of a PIPE or clients of a SOCKET, defaults to 1)" << "\n" \
+    << "\t\"ttl\": INTEGER, (PIPE and SOCKET only, seconds the secret remains available to further readers)" << "\n" \
+    << "\t\"unseal\": \"EAGER\" | \"LAZY\" | \"KEYFIRST\", (PIPE and SOCKET only, defaults to EAGER)" << "\n" \
+    << "\t\"priority\": INTEGER, (higher first when the Tang server is saturated, defaults to 0)" << "\n" \
+    << "\t\"member\": NAME, (the JWE is a bundle, only deliver this member of it)" << "\n" \
+    << "\t\"command\": [ BINARY, ARG, ... ], (EXEC only)" << "\n" \
+    << "\t\"fd\": INTEGER, (EXEC only, descriptor of the workload holding the secret, defaults to 0 i.e. stdin)" << "\n" \
+    << "\t\"replace\": BOOLEAN (EXEC only, latchy becomes the workload)" << "\n" \
     << "}" << "\n" \
 
+    << "\n" \
+    << "With \"SOCKET\", each client connecting to the Unix socket \"out\" receives (SCM_RIGHTS) a descriptor to a" << "\n" \
+    << "sealed memfd holding the secret. Only root and latchy's own user are served." << "\n" \
+    << "\n" \
+    << "With \"unseal\" set to \"LAZY\", the JWE is read and checked right away but Tang is only contacted once a" << "\n" \
+    << "client opens the PIPE or connects to the SOCKET, so secrets nobody asks for are never unsealed. With" << "\n" \
+    << "\"KEYFIRST\", Tang is contacted right away and only the decryption waits for the client." << "\n" \
+    << "Declarations whose \"in\" files hold the same JWE (with the same \"unseal\" and \"priority\") share a single" << "\n" \
+    << "unsealing, the secret is only wiped once all of them delivered it." << "\n" \
+    << "\n" \
+    << "A bundle is a JWE whose plaintext is a JSON object of named secrets, such as {\"db\": \"...\", \"api\": \"...\"}." << "\n" \
+    << "Declare it once per \"member\", each with its own output, the bundle is unsealed once for all. A string" << "\n" \
+    << "member is delivered as is, any other value as compact JSON." << "\n" \
+    << "\n" \
+    << "The full format also takes limits on the Tang servers, requests beyond them wait by priority" << "\n" \
+    << "\t\"maxInFlight\": INTEGER, (for every Tang server without a limit below, defaults to 0 i.e. no limit)" << "\n" \
+    << "\t\"tang\": [ { \"url\": URL, \"maxInFlight\": INTEGER } ], (URL as found in the JWE)" << "\n" \
+    << "\n" \
+    << "With \"EXEC\", latchy starts the workload given by \"command\" and streams the secret into descriptor \"fd\"" << "\n" \
+    << "of that workload. With \"replace\", latchy execs in place instead. This is only accepted when the EXEC" << "\n" \
+    << "declaration is the only one in the configuration, and never by the agent." << "\n" \
+    << "\n" \
+    << "With \"IDIRECTORY\", latchy keeps running and processes each file closed in or moved to the directory, in" << "\n" \
+    << "arrival order. In \"out\", {name} is replaced by the file name without its extension and {file} by the full" << "\n" \
+    << "file name. Once processed, a file is moved to the done/ subdirectory, or to failed/ when it could not be" << "\n" \
+    << "delivered." << "\n" \
+
+    << "\n" \
+    << "Agent mode. With --agent, latchy stays resident and serves one request per connection on the socket. A" << "\n" \
+    << "request is a single line holding the configuration for a single JWE. With \"STDIN\" the JWE follows that line" << "\n" \
+    << "(shut down the writing side once sent). The answer is a status line, \"OK\" or \"ERROR - <reason>\". With" << "\n" \
+    << "\"STDOUT\" the clear-text secret follows the \"OK\" line. Only root and the agent's own user are served." << "\n" \
+
     << std::endl;
 
   return;
@@ -16,6 +16,12 @@
 #include "fileAccess.h"
 
 #include <fstream>
+#include <algorithm>
+
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
 
 namespace helpers {
 namespace fileAccess {
@@ -36,35 +42,72 @@ void writeTo(const std::filesystem::path& file, const std::string& data, bool ap
  
 const std::string readAll(const std::filesystem::path& file) {
   std::string         retval;
+  std::error_code     ec = readFile(file, retval);
+
+  if (ec == std::errc::no_such_file_or_directory) {
+    throw fileNotFound(file);
+  } else if (ec) {
+    throw canNotOpen(file, false);
+  }
+  return retval;
+}
 
-  if (std::filesystem::exists(file) == true) {
-    std::ifstream     filehandle(file.string(), std::ios::binary | std::ios::in);
+std::error_code readFile(const std::filesystem::path& file, std::string& content, bool preserveBytes, int openFlags) noexcept {
+  content.clear();
 
-    if (filehandle.is_open() == false) {
-      throw canNotOpen(file, false);
-    }
+  int                 descriptor = open(file.c_str(), O_RDONLY | O_CLOEXEC | openFlags);
+  if (descriptor < 0) {
+    return std::error_code(errno, std::system_category());
+  }
 
-    try {
-      filehandle.exceptions(std::ios::failbit | std::ios::badbit);
-      while (true) {
-        std::string   readval;
-        std::getline(filehandle, readval);
-        retval += readval;
+  std::error_code     ec;
+  struct stat         status;
+  if (fstat(descriptor, &status) != 0) {
+    ec = std::error_code(errno, std::system_category());
+    close(descriptor);
+    return ec;
+  }
+
+  try {
+    // A regular file is read with a single call, into a buffer of its size. Pseudo files (/proc, /sys) report
+    // a size of 0 and are read by chunks until EOF
+    bool              sized = (S_ISREG(status.st_mode) and (status.st_size > 0));
+    std::size_t       used = 0;
+    content.resize(sized ? status.st_size : 4096);
+
+    while (true) {
+      if (used == content.size()) {
+        if (sized == true) {
+          break;
+        }
+        content.resize(2*content.size());
       }
-      filehandle.close();
-      return retval;  
-    } catch (std::exception& exc) {
-      if (filehandle.eof() == true) {
-        // Normal case of reading up to the end. Just return
-        filehandle.close();
-        return retval;
+
+      ssize_t         n = pread(descriptor, content.data() + used, content.size() - used, used);
+      if (n > 0) {
+        used += n;
+      } else if (n == 0) {
+        break;
+      } else if (errno != EINTR) {
+        ec = std::error_code(errno, std::system_category());
+        break;
       }
-      throw;
     }
-    
-  } else {
-    throw fileNotFound(file);
+    content.resize(used);
+
+    if (preserveBytes == false) {
+      // What readAll always did, the lines are joined
+      content.erase(std::remove(content.begin(), content.end(), '\n'), content.end());
+    }
+  } catch (const std::bad_alloc&) {
+    ec = std::make_error_code(std::errc::not_enough_memory);
+  }
+
+  close(descriptor);
+  if (ec) {
+    content.clear();
   }
+  return ec;
 }
 
 const std::string getSymlink(const std::filesystem::path& file) {
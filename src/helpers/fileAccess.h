@@ -18,16 +18,17 @@
 #include <string>
 #include <stdexcept>
 #include <filesystem>
+#include <system_error>
 
 namespace helpers {
 namespace fileAccess {
   using namespace std;
 
  void                           writeTo(const std::filesystem::path& file, const std::string& data, bool append);
- const std::string              readAll(const std::filesystem::path& file);
+ const std::string              readAll(const std::filesystem::path& file);      // Lines are joined (no '\n'), throws on failure
+ std::error_code                readFile(const std::filesystem::path& file, std::string& content, bool preserveBytes = false, int openFlags = 0) noexcept;   // Lines are joined unless preserveBytes. openFlags are added to O_RDONLY, such as O_NOFOLLOW
  const std::string              getSymlink(const std::filesystem::path& file);
 
-
   class error: public std::runtime_error {
   public:
     error(const std::string& msg): std::runtime_error(msg) {}  
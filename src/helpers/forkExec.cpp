@@ -18,16 +18,79 @@
 
 #include <chrono>
 #include <cstring>
-#include <thread>
+#include <memory>
+#include <sched.h>
+#include <pthread.h>
+#include <signal.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/syscall.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <algorithm>
+
+#ifndef SYS_close_range
+#define SYS_close_range 436
+#endif
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+#ifndef CLOSE_RANGE_CLOEXEC
+#define CLOSE_RANGE_CLOEXEC (1U << 2)
+#endif
 
 namespace os {
 namespace launch {
   using namespace std::chrono_literals;
 
+  // Everything the child needs, prepared by the parent before the clone. The child shares our memory
+  // (CLONE_VM) until it execs, so it must not allocate, lock or log. It only reads this.
+  struct spawnData {
+    std::string                 command;
+    std::vector<char*>          argv;
+    std::vector<char*>          envp;              // Empty means inherit our environment
+    const char*                 initialDirectory = nullptr;
+    int                         intFD = -1;
+    int                         outFD = -1;
+    int                         errFD = -1;
+    int                         intAs = STDIN_FILENO;
+    sigset_t                    childMask;
+    volatile int                childErrno = 0;    // Written by the child when it fails before the exec
+  };
+
+  void prepareArguments(spawnData& data, const std::string& binaryFilename, const cmdArgList_t& arg, const cmdEnvList_t& env) {
+    // Convert arg and env to a suitable argument for the underlying execv
+    data.command = binaryFilename;
+    data.argv.reserve(arg.size() + 2);
+    data.argv.push_back(data.command.data());
+    for (const auto& item : arg) {
+      if (item.find('\0') != std::string::npos) {
+        throw NotValid();
+      }
+      data.argv.push_back(const_cast<char*>(item.c_str()));
+    }
+    data.argv.push_back(nullptr);
+
+    if (env.empty() == false) {
+      data.envp.reserve(env.size() + 1);
+      for (const auto& item : env) {
+        if (item.find('\0') != std::string::npos) {
+          throw NotValid();
+        }
+        data.envp.push_back(const_cast<char*>(item.c_str()));
+      }
+      data.envp.push_back(nullptr);
+    }
+  }
+
+  bool hasCloseRange() {
+    // An empty range is accepted by any kernel supporting close_range (5.11+ for CLOSE_RANGE_CLOEXEC)
+    static const bool       supported = (syscall(SYS_close_range, ~0U, ~0U, CLOSE_RANGE_CLOEXEC) == 0);
+    return supported;
+  }
+
   int largestFD() {
-    // Largest FD ID for current process (using info in proc)
+    // Largest FD ID for current process (using info in proc). Only used when close_range is not available
     int         largest = 0;
 
     for (const auto& fileEntry : std::filesystem::directory_iterator("/proc/self/fd")) { 
@@ -42,96 +105,155 @@ namespace launch {
     return largest; 
   }
 
-  int execvpe(const std::string& binaryFilename, const cmdArgList_t arg, const cmdEnvList_t env) {
-    // Convert arg to a suitable argument for the underlying execv
-    char *            argv[arg.size()+2];
-    std::string       command(binaryFilename);
-    argv[0] = command.data();
-    argv[arg.size()+1] = nullptr;
-    for (std::size_t i = 0; i < arg.size(); ++i) {
-      if ( (arg[i].empty() == true) and (arg[i].back() != 0) ) {
-        throw NotValid();
+  int childMain(void* arg) {
+    // We are in the child from this point on. There is no way out, besides the exec
+    spawnData&          data = *static_cast<spawnData*>(arg);
+
+    // Handlers belong to the parent, whose memory we still share. Back to the defaults before unblocking, but
+    // only for caught signals: an ignored one stays ignored across the exec (nohup, SIGPIPE), as with fork and
+    // posix_spawn
+    struct sigaction    defaultAction;
+    memset(&defaultAction, 0, sizeof(defaultAction));
+    defaultAction.sa_handler = SIG_DFL;
+    for (int signal = 1; signal < NSIG; ++signal) {
+      struct sigaction  current;
+      if ( (sigaction(signal, nullptr, &current) == 0) and (current.sa_handler != SIG_DFL) and (current.sa_handler != SIG_IGN) ) {
+        sigaction(signal, &defaultAction, nullptr);
       }
+    }
 
-      argv[i+1] = const_cast<char*>(arg[i].data());
+    // Update the CWD
+    if ( (data.initialDirectory != nullptr) and (chdir(data.initialDirectory) != 0) ) {
+      data.childErrno = errno;
+      _exit(72);
     }
 
-    // Convert env to a suitable argument for the underlying execv
-    char *            envp[env.size()+1];
-    envp[env.size()] = nullptr;
-    for (std::size_t i = 0; i < env.size(); ++i) {
-      if ( (env[i].empty() == true) and (env[i].back() != 0) ) {
-        throw NotValid();
-      }
+    // Nothing beyond stdin, stdout and stderr survives the exec. dup2() below clears FD_CLOEXEC on its target,
+    // which is how the redirected input survives when it is not stdin. Without a dup2() (the input already has
+    // the wanted number) the flag is cleared explicitly
+    if (syscall(SYS_close_range, 3U, ~0U, CLOSE_RANGE_CLOEXEC) != 0) {
+      data.childErrno = errno;
+      _exit(72);
+    }
+
+    //
+    // setup redirection
+    //
+    if ( (data.intFD != -1) and (data.intFD != data.intAs) ) {
+      dup2(data.intFD, data.intAs);
+    } else if ( (data.intFD != -1) and (data.intAs > STDERR_FILENO) ) {
+      fcntl(data.intAs, F_SETFD, 0);
+    }
+    if ( (data.outFD != -1) and (data.outFD != STDOUT_FILENO) ) {
+      dup2(data.outFD, STDOUT_FILENO);
+    }
+    if ( (data.errFD != -1) and (data.errFD != STDERR_FILENO) ) {
+      dup2(data.errFD, STDERR_FILENO);
+    }
 
-      envp[i] = const_cast<char*>(env[i].data());
+    // Unblock all signals
+    sigprocmask(SIG_SETMASK, &data.childMask, nullptr);
+
+    //
+    // Point of no return - Start the new binary (ie replace the memory content...)
+    //
+    if (data.envp.empty() == false) {
+      ::execvpe(data.command.c_str(), data.argv.data(), data.envp.data());
+    } else {
+      ::execvp(data.command.c_str(), data.argv.data());
     }
+    data.childErrno = errno;
+    _exit(72);
+  }
 
-    if (env.empty() == false) {
-      return ::execvpe(binaryFilename.data(), argv, envp);
+  int execvpe(const std::string& binaryFilename, const cmdArgList_t arg, const cmdEnvList_t env) {
+    spawnData           data;
+    prepareArguments(data, binaryFilename, arg, env);
+
+    if (data.envp.empty() == false) {
+      return ::execvpe(data.command.c_str(), data.argv.data(), data.envp.data());
     } else {
-      return ::execvp(binaryFilename.data(), argv);
+      return ::execvp(data.command.c_str(), data.argv.data());
     }
   }
 
-  int launch(const std::string& binaryPath, const cmdArgList_t arg, const std::string initialDirectory, int intFD, int outFD, int errFD, const cmdEnvList_t env) {
-    // We must not allocate memory after fork(),
-    // therefore allocate all required buffers first.
+  int forkLaunch(spawnData& data) {
+    // Fallback for kernels without close_range. The whole parent is duplicated (copy-on-write)
+    int                 maxFD = largestFD();
     int pid = fork();
-    if (pid < 0) {
-      // Error
-      throw std::runtime_error(std::string("Cannot fork process for ") + binaryPath);
-    } else if (pid == 0) {
-      // We are in the child from this point on. There is no way out
-      int       maxFD = largestFD();
-      DEBUG() << "In the child, immediatelly after the fork - " << "Maximum number of file descriptor " << sysconf(_SC_OPEN_MAX) << std::endl;
-      DEBUG() << "Detected largest FD ID " << maxFD << std::endl;
-
-      // Update the CWD
-      if (initialDirectory.empty() == false) {
-        if (chdir(initialDirectory.c_str()) != 0) {
-          _exit(72);
-        }
+    if (pid == 0) {
+      if ( (data.initialDirectory != nullptr) and (chdir(data.initialDirectory) != 0) ) {
+        _exit(72);
       }
-
-      //
-      // setup redirection
-      //
-      if ( (intFD != -1) and (intFD != STDIN_FILENO) ) {
-        dup2(intFD, STDIN_FILENO);
-        close(intFD);
+      if ( (data.intFD != -1) and (data.intFD != data.intAs) ) {
+        dup2(data.intFD, data.intAs);
+      } else if ( (data.intFD != -1) and (data.intAs > STDERR_FILENO) ) {
+        fcntl(data.intAs, F_SETFD, 0);      // Pipes are made O_CLOEXEC, only dup2() would have cleared it
       }
-
-      if ( (outFD != -1) and (outFD != STDOUT_FILENO) ) {
-        dup2(outFD, STDOUT_FILENO);
-        close(outFD);
+      if ( (data.outFD != -1) and (data.outFD != STDOUT_FILENO) ) {
+        dup2(data.outFD, STDOUT_FILENO);
       }
-
-      if ( (errFD != -1) and (errFD != STDERR_FILENO) ) {
-        dup2(errFD, STDERR_FILENO);
-        close(errFD);
+      if ( (data.errFD != -1) and (data.errFD != STDERR_FILENO) ) {
+        dup2(data.errFD, STDERR_FILENO);
       }
 
-      // close all open file descriptors other than stdin, stdout, stderr
-      for (int i = 3; i < maxFD; ++i) {
+      // close all open file descriptors other than stdin, stdout, stderr (and the input, when it is not stdin)
+      for (int i = 3; i <= maxFD; ++i) {
+        if ( (data.intFD != -1) and (i == data.intAs) ) {
+          continue;
+        }
         close(i);
       }
 
-      // Unblock all signals
-      sigset_t            signalSet;
-      sigfillset(&signalSet);
-      sigprocmask(SIG_UNBLOCK, &signalSet, nullptr);
+      sigprocmask(SIG_SETMASK, &data.childMask, nullptr);
+      if (data.envp.empty() == false) {
+        ::execvpe(data.command.c_str(), data.argv.data(), data.envp.data());
+      } else {
+        ::execvp(data.command.c_str(), data.argv.data());
+      }
+      _exit(72);
+    }
+    return pid;
+  }
 
-      //
-      // Point of no return - Start the new binary (ie replace the memory content...)
-      //
-      DEBUG() << "In the child,just before the exec" << std::endl;
+  int launch(const std::string& binaryPath, const cmdArgList_t arg, const std::string initialDirectory, int intFD, int outFD, int errFD, const cmdEnvList_t env, int intAs) {
+    // We must not allocate memory after the clone, therefore allocate all required buffers first.
+    spawnData           data;
+    prepareArguments(data, binaryPath, arg, env);
+    data.initialDirectory = (initialDirectory.empty() == true) ? nullptr : initialDirectory.c_str();
+    data.intFD = intFD;
+    data.outFD = outFD;
+    data.errFD = errFD;
+    data.intAs = intAs;
+    sigemptyset(&data.childMask);
+
+    int                 pid = -1;
+    if (hasCloseRange() == true) {
+      // vfork semantic: the child borrows our memory (no page table copy, whatever our size) and we resume
+      // once it exec'ed. Signals are blocked meanwhile so that none of our handlers runs in the child.
+      constexpr std::size_t   stackSize = 64*1024;
+      std::unique_ptr<char[]> stack(new char[stackSize]);
+      sigset_t                all;
+      sigset_t                previous;
+      sigfillset(&all);
+      pthread_sigmask(SIG_SETMASK, &all, &previous);
+
+      pid = clone(childMain, stack.get() + stackSize, CLONE_VM | CLONE_VFORK | SIGCHLD, &data);
+
+      pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+    } else {
+      pid = forkLaunch(data);
+    }
 
-      execvpe(binaryPath, arg, env);
-      _exit(72);
+    if (pid < 0) {
+      // Error
+      throw std::runtime_error(std::string("Cannot fork process for ") + binaryPath);
     }
 
-    DEBUG() << "In parent just after the fork" << std::endl;
+    DEBUG() << "In parent just after launching " << binaryPath << ", pid " << pid << std::endl;
+    if (data.childErrno != 0) {
+      DEBUG() << "The child failed before the exec - " << strerror(data.childErrno) << std::endl;
+    }
 
     // Parent. - Close the end of the pipe we gave to the child
     if ( (intFD != -1) and (intFD != STDIN_FILENO) ) {
@@ -148,12 +270,14 @@ namespace launch {
     return pid;
   }
 
-  exec::exec(const cmdLine_t& cmdline, bool block, bool openStdin, bool captureStdout, bool captureStderr) {
+  exec::exec(const cmdLine_t& cmdline, bool block, bool openStdin, bool captureStdout, bool captureStderr, int stdinAs, sink_t stdoutSink, sink_t stderrSink):
+    outputSink(std::move(stdoutSink)), errorSink(std::move(stderrSink)) {
     if (cmdline.empty() == true) {
       throw std::runtime_error(std::string("Mssing command to start a child "));
     }
 
-    // Setup the pipes, if requested
+    // Setup the pipes, if requested. Our ends are non blocking, the child's ends are made blocking again by
+    // the dup2() to its standard descriptors
     int         childInputPipe = -1;
     int         childOutputPipe = -1;
     int         childErrorPipe = -1;
@@ -161,126 +285,107 @@ namespace launch {
     // STDIN of the child
     if (openStdin == true) {
       int fds[2];
-      int rc = pipe(fds);
+      int rc = pipe2(fds, O_CLOEXEC);
       if (rc == 0) {
         childInputPipe  = fds[0];
         inputPipe = fds[1];
+        fcntl(inputPipe, F_SETFL, O_NONBLOCK);
       } else {
         throw std::runtime_error(std::string("Can not create pipe ") + std::strerror(errno));
       }
+
+      wakeEvent = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+      if (wakeEvent < 0) {
+        throw std::runtime_error(std::string("Can not create eventfd ") + std::strerror(errno));
+      }
     }
 
     // STDOUT of the child
-    if (captureStdout == true) {
+    if ( (captureStdout == true) or (outputSink) ) {
       int fds[2];
-      int rc = pipe(fds);
+      int rc = pipe2(fds, O_CLOEXEC | O_NONBLOCK);
       if (rc == 0) {
         outputPipe  = fds[0];
         childOutputPipe = fds[1];
+        fcntl(childOutputPipe, F_SETFL, 0);
       } else {
         throw std::runtime_error(std::string("Can not create pipe ") + std::strerror(errno));
       }
     }
 
     // STDERR of the child
-    if (captureStderr == true) {
+    if ( (captureStderr == true) or (errorSink) ) {
       int fds[2];
-      int rc = pipe(fds);
+      int rc = pipe2(fds, O_CLOEXEC | O_NONBLOCK);
       if (rc == 0) {
         errorPipe  = fds[0];
         childErrorPipe = fds[1];
+        fcntl(childErrorPipe, F_SETFL, 0);
       } else {
         throw std::runtime_error(std::string("Can not create pipe ") + std::strerror(errno));
       }
     }
 
-    for (const auto& item : cmdline) {
-      //DEBUG() << item << std::endl;
-    }
-
-    exitCodeTask = std::async([&, cmdline, childInputPipe, childOutputPipe, childErrorPipe]() { return execute(cmdline, childInputPipe, childOutputPipe, childErrorPipe); } );
-
-    if (captureStdout == true) {
-      captureStdoutTask = std::async([&]() { return serviceOutputPipe(false); } );
-    }
-    if (captureStderr == true) {
-      captureStderrTask = std::async([&]() { return serviceOutputPipe(true); } );
-    }
+    exitCodeTask = std::async(std::launch::async, [&, cmdline, childInputPipe, childOutputPipe, childErrorPipe, stdinAs]() { return execute(cmdline, childInputPipe, childOutputPipe, childErrorPipe, stdinAs); } ).share();
 
     if (block == true) {
       exitCodeTask.wait();
-
-      if (captureStdoutTask.valid() == true) {
-        captureStdoutTask.wait();
-      }
-      if (captureStderrTask.valid() == true) {
-        captureStderrTask.wait();
-      }
     }
 
   };
 
-  bool exec::isTerminate(seconds waitFor) const {
-    // We think the std::future methods are thread safe by nature... std::scoped_lock lock(_mutex);
-
-    // There may be a rare condition where we could end up waiting 3x the waitFor delay.
-
-    if (exitCodeTask.valid() == false) {
-      throw std::future_error(std::future_errc::no_state);
-    }
-
-    DEBUG() << "   Check if child terminated " << std::endl;
-    if (exitCodeTask.wait_for(waitFor) != std::future_status::ready) {
-      return false;
+  exec::~exec() {
+    if (exitCodeTask.valid() == true) {
+      exitCodeTask.wait();
     }
-
-    DEBUG() << "   Check if child's output grabbing is complete (if configured to grab) " << std::endl;
-    if (captureStdoutTask.valid() == true) {
-      if (captureStdoutTask.wait_for(waitFor) != std::future_status::ready) {
-        return false;
+    // Only left open when the child could not be started
+    for (int fd : { inputPipe, outputPipe, errorPipe, wakeEvent }) {
+      if (fd >= 0) {
+        close(fd);
       }
     }
+  }
 
-    DEBUG() << "   Check if child's error output grabbing is complete (if configured to grab) " << std::endl;
-    if (captureStderrTask.valid() == true) {
-      if (captureStderrTask.wait_for(waitFor) != std::future_status::ready) {
-        return false;
-      }
+  bool exec::isTerminate(seconds waitFor) const {
+    if (exitCodeTask.valid() == false) {
+      throw std::future_error(std::future_errc::no_state);
     }
 
-   return true;
+    // The task only completes once the child exited and its output is fully collected
+    return exitCodeTask.wait_for(waitFor) == std::future_status::ready;
   }
 
   void exec::sendBuffer(const std::string& data, bool close) {
     if (isTerminate(0s) == true) {
       throw std::runtime_error(std::string("Sending data to a child that already terminated"));
     }
-    if (inputPipe < 0) {
+    if (wakeEvent < 0) {
       // Invalid pipe
       throw std::runtime_error(std::string("No pipe to send data to"));
     }
 
-    // Add data to the internal buffer
+    // Add data to the internal buffer, the event loop takes it from there
     {
       std::scoped_lock lock(_mutex);
       inputBuffer.append(data);
       mustClose = close;
     }
 
-    // Start the service task if needed
-    if (stdinTask.valid() == false) {
-      stdinTask = std::async([&]() { return serviceInputPipe(); } );
+    uint64_t          one = 1;
+    if (write(wakeEvent, &one, sizeof(one)) < 0) {
+      DEBUG() << "Failed to wake the event loop - " << strerror(errno) << std::endl;
     }
   }
 
   void exec::clearBuffer() {
     // Used when sensitive data is potentially present in buffers
+    std::scoped_lock lock(_mutex);
     inputBuffer.assign(inputBuffer.size(), (char) 0);
     outputBuffer.assign(outputBuffer.size(), (char) 0);
     errorBuffer.assign(errorBuffer.size(), (char) 0);
   }
 
-  int exec::execute(const cmdLine_t& cmdline, int intFD, int outFD, int errFD) {
+  int exec::execute(const cmdLine_t& cmdline, int intFD, int outFD, int errFD, int intAs) {
     std::string                        binary = cmdline[0];
     cmdArgList_t                       arg;
     if (cmdline.size() >= 2) {
@@ -288,31 +393,120 @@ namespace launch {
     }
 
     DEBUG() << "Launching a child " << binary << std::endl;
-    pid = launch(binary, arg, "", intFD, outFD, errFD);
+    pid = launch(binary, arg, "", intFD, outFD, errFD, cmdEnvList_t(), intAs);
     DEBUG() << "PID is " << pid << std::endl;
 
+    // Without pidfd (before 5.3) the exit is polled for
+    int                                pidFD = syscall(SYS_pidfd_open, pid, 0);
+    int                                epollFD = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFD < 0) {
+      throw std::runtime_error(std::string("Can not create the epoll object ") + std::strerror(errno));
+    }
+
+    auto watch = [&](int fd, uint32_t events) {
+      struct epoll_event   event;
+      memset(&event, 0, sizeof(event));
+      event.events = events;
+      event.data.fd = fd;
+      epoll_ctl(epollFD, EPOLL_CTL_ADD, fd, &event);
+    };
+    if (pidFD >= 0)      watch(pidFD, EPOLLIN);
+    if (outputPipe >= 0) watch(outputPipe, EPOLLIN);
+    if (errorPipe >= 0)  watch(errorPipe, EPOLLIN);
+    if (wakeEvent >= 0)  watch(wakeEvent, EPOLLIN);
+    if (inputPipe >= 0)  watch(inputPipe, 0);       // EPOLLOUT only while there is something to send
+    auto release = [&](int& fd) {
+      epoll_ctl(epollFD, EPOLL_CTL_DEL, fd, nullptr);
+      close(fd);
+      fd = -1;
+    };
+
+    int                                exitStatus = -1;
+    bool                               inputWanted = false;
+    while ( (exitStatus == -1) or (outputPipe >= 0) or (errorPipe >= 0) ) {
+      // Interest in the input pipe follows the pending data
+      bool                             pending = false;
+      if (inputPipe >= 0) {
+        std::scoped_lock lock(_mutex);
+        pending = (inputBuffer.empty() == false) or (mustClose == true);
+      }
+      if ( (inputPipe >= 0) and (pending != inputWanted) ) {
+        struct epoll_event   event;
+        memset(&event, 0, sizeof(event));
+        event.events = pending ? static_cast<uint32_t>(EPOLLOUT) : 0u;
+        event.data.fd = inputPipe;
+        epoll_ctl(epollFD, EPOLL_CTL_MOD, inputPipe, &event);
+        inputWanted = pending;
+      }
+
+      struct epoll_event               events[4];
+      int                              count = epoll_wait(epollFD, events, 4, (pidFD >= 0) ? -1 : 100);
+      if ( (count < 0) and (errno != EINTR) ) {
+        DEBUG() << "Failed to wait for the child's events - " << strerror(errno) << std::endl;
+        break;
+      }
+
+      for (int i = 0; i < count; ++i) {
+        int                            fd = events[i].data.fd;
+        if (fd == wakeEvent) {
+          uint64_t                     value;
+          while (read(wakeEvent, &value, sizeof(value)) > 0) {}
+        } else if (fd == inputPipe) {
+          if (serviceInputPipe() == false) {
+            release(inputPipe);
+          }
+        } else if (fd == outputPipe) {
+          if (serviceOutputPipe(outputPipe, outputBuffer, outputSink) == false) {
+            release(outputPipe);
+          }
+        } else if (fd == errorPipe) {
+          if (serviceOutputPipe(errorPipe, errorBuffer, errorSink) == false) {
+            release(errorPipe);
+          }
+        } else if ( (fd == pidFD) and (exitStatus == -1) ) {
+          exitStatus = reap(pidFD);
+          epoll_ctl(epollFD, EPOLL_CTL_DEL, pidFD, nullptr);
+        }
+      }
+
+      if ( (pidFD < 0) and (exitStatus == -1) ) {
+        exitStatus = reap(-1);
+      }
+
+      // Once the child is gone, its stdin is of no use. This makes sure nobody blocks on it
+      if ( (exitStatus != -1) and (inputPipe >= 0) ) {
+        release(inputPipe);
+      }
+    }
+
+    close(epollFD);
+    if (pidFD >= 0) {
+      close(pidFD);
+    }
+    if (exitStatus == -1) {
+      throw std::runtime_error("Cannot wait for process " + std::to_string(pid));
+    }
+    return exitStatus;
+  }
+
+  int exec::reap(int pidFD) {
+    // -1 while the child is still running
     int                                status = 0;
     int                                rc = 0;
 
     do {
-      DEBUG() << "Waiting for child, which pid is " << pid << std::endl;
-      rc = waitpid(pid, &status, (int)0);
-      DEBUG() << "Waited for child, rc is " << rc << std::endl;
+      rc = waitpid(pid, &status, (pidFD >= 0) ? 0 : WNOHANG);
     }
     while (rc < 0 && errno == EINTR);
 
-    DEBUG() << "Done waiting for child" << std::endl;
+    if (rc == 0) {
+      return -1;
+    }
     if (rc != pid) {
       throw std::runtime_error("Cannot wait for process " + std::to_string(pid));
     }
 
-    // Close the stdin pipe. This makes sure the service thread unblocks / terminates
-    if (inputPipe >= 0) {
-      close (inputPipe);
-      inputPipe = -1;
-    }
-
-    DEBUG() << "Done waiting for child, returning status 0x" << std::hex << status << std::dec << std::endl;
+    DEBUG() << "Done waiting for child, status 0x" << std::hex << status << std::dec << std::endl;
     if (WIFEXITED(status)) {
       return WEXITSTATUS(status);       // normal termination
     } else {
@@ -320,82 +514,94 @@ namespace launch {
     }
   }
 
-  void exec::serviceInputPipe() {
-    // This executes in its own thread. We can therefore use blocking IO....
-    // We copy, again, the data from the buffer. Not efficient but we do not expect that
-    // much data anyway. To be optimized if needed
-
-    std::string       buf;
-    while(inputPipe != -1) {
-      // Grab the data
-      {
-        std::scoped_lock lock(_mutex);
-        buf.append(inputBuffer);
-        inputBuffer.clear();
+  ssize_t exec::writeNoSignal(int fd, const void* data, std::size_t size) {
+    // A pipe has no MSG_NOSIGNAL. When the child closed its end, the write would raise SIGPIPE and kill us,
+    // so the signal is blocked for this thread around the write, and consumed if it became pending
+    sigset_t          pipeSignal;
+    sigset_t          previous;
+    sigemptyset(&pipeSignal);
+    sigaddset(&pipeSignal, SIGPIPE);
+
+    sigset_t          pending;
+    sigpending(&pending);
+    bool              alreadyPending = (sigismember(&pending, SIGPIPE) == 1);
+
+    pthread_sigmask(SIG_BLOCK, &pipeSignal, &previous);
+    ssize_t           n = write(fd, data, size);
+    int               writeError = errno;
+
+    if ( (n < 0) and (writeError == EPIPE) and (alreadyPending == false) ) {
+      const struct timespec   noWait = { 0, 0 };
+      while ( (sigtimedwait(&pipeSignal, nullptr, &noWait) < 0) and (errno == EINTR) ) {
       }
+    }
+    pthread_sigmask(SIG_SETMASK, &previous, nullptr);
 
-      if (buf.empty() == false) {
-        int n;
-        do
-        {
-          n = write(inputPipe, buf.data(), buf.size());
-        }
-        while (n < 0 && errno == EINTR);
-        if (n < 0) {
-          // An error is reported. We do not really care why so we just return.
-          close (inputPipe);
-          inputPipe = -1;
-          return;
-        }
+    errno = writeError;
+    return n;
+  }
 
-        // Erase the data we successfully sent
-        buf.replace(0, n, n, 0);  // Make sure to invalidate the data, which may be sensitive
-        buf.erase(0, n);
-      } else {
-        std::this_thread::sleep_for (100ms);
-      }
+  bool exec::serviceInputPipe() {
+    // Returns false once the pipe should be closed, either because we are done or because the child does
+    // not read anymore. Writes directly from the shared buffer, no extra copy of data that may be sensitive
+    std::scoped_lock lock(_mutex);
 
-      // We were told that we should be done
-      if ( (mustClose == true) and (buf.empty() == true) ) {
-        std::scoped_lock lock(_mutex);
-        if (inputBuffer.empty() == true) {
-          close (inputPipe);
-          inputPipe = -1;
+    while (inputBuffer.empty() == false) {
+      ssize_t           n = writeNoSignal(inputPipe, inputBuffer.data(), inputBuffer.size());
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        if ( (errno == EAGAIN) or (errno == EWOULDBLOCK) ) {
+          return true;
         }
+        // An error is reported, EPIPE when the child closed its end. We do not really care why so we just close.
+        return false;
       }
 
+      // Erase the data we successfully sent
+      inputBuffer.replace(0, n, n, 0);  // Make sure to invalidate the data, which may be sensitive
+      inputBuffer.erase(0, n);
     }
 
-    return;
+    // We were told that we should be done
+    return mustClose == false;
   }
 
-  void exec::serviceOutputPipe(bool stderr) {
-    // This executes in its own thread. We can therefore use blocking IO....
-    int&       fd = (stderr ? errorPipe : outputPipe);
+  bool exec::serviceOutputPipe(int fd, std::string& buffer, const sink_t& sink) {
+    // Drains what is available. Returns false at EOF
+    char              chunk[16384];
 
-    while(fd != -1) {
-      int     n = 0;
-      char    buffer[4096];
-      do
-      {
-        n = read(fd, buffer, 4096);
-      }
-      while (n < 0 && errno == EINTR);
-
-      if (n <= 0) {
-        // An error is reported. We do not really care why so we just return.
-        // 0 means eof
-        close (fd);
-        fd = -1;
-        return;
+    while (true) {
+      ssize_t         n;
+      if (sink) {
+        n = read(fd, chunk, sizeof(chunk));
+        if (n > 0) {
+          sink(std::string_view(chunk, n));
+        }
+      } else {
+        // Read straight into the buffer, which grows geometrically
+        std::size_t   used = buffer.size();
+        if (buffer.capacity() - used < sizeof(chunk)) {
+          buffer.reserve(std::max(2*buffer.capacity(), used + sizeof(chunk)));
+        }
+        buffer.resize(buffer.capacity());
+        n = read(fd, buffer.data() + used, buffer.size() - used);
+        buffer.resize(used + std::max<ssize_t>(n, 0));
       }
 
       if (n > 0) {
-        //Move the data into the final buffer return n;
-        std::scoped_lock lock(_mutexOutput);
-        std::string&    serviceBuffer = (stderr ? errorBuffer : outputBuffer);
-        serviceBuffer.append(buffer, n);
+        continue;
+      }
+      if ( (n < 0) and (errno == EINTR) ) {
+        continue;
       }
+      if ( (n < 0) and ( (errno == EAGAIN) or (errno == EWOULDBLOCK) ) ) {
+        return true;
+      }
+
+      // 0 means eof, anything else is an error we do not really care about
+      return false;
     }
   }
 
@@ -21,6 +21,7 @@
 #include <vector>
 #include <future>
 #include <mutex>
+#include <functional>
 #include <chrono>
 
 #include <sys/types.h>
@@ -50,20 +51,29 @@ namespace launch {
 
   //template
   int        execvpe(const std::string& binaryFilename, const cmdArgList_t arg, const cmdEnvList_t env);
-  int        launch(const std::string& binaryPath, const cmdArgList_t arg, const std::string initialDirectory = "", int intFD = -1, int outFD = -1, int errFD = -1, const cmdEnvList_t env = cmdEnvList_t());
-
+  int        launch(const std::string& binaryPath, const cmdArgList_t arg, const std::string initialDirectory = "", int intFD = -1, int outFD = -1, int errFD = -1, const cmdEnvList_t env = cmdEnvList_t(), int intAs = STDIN_FILENO);
+
+  /// A child with its standard streams connected to us
+  ///
+  /// A single task per child drives its stdin, stdout and stderr pipes with epoll and learns about the exit
+  /// through a pidfd. The captured output is owned by that task until the child exited and the pipes
+  /// reached EOF, which is when getOutput() and getError() return. A sink, when given, receives the output
+  /// as it arrives instead of it being buffered.
   class exec {
   public:
+    using sink_t =                       std::function<void(std::string_view)>;
+
   public:
-    exec(const cmdLine_t& cmdline, bool block = true, bool stdin = false, bool captureStdout = false, bool captureStderr = false);
-    virtual ~exec () {};
+    exec(const cmdLine_t& cmdline, bool block = true, bool stdin = false, bool captureStdout = false, bool captureStderr = false, int stdinAs = STDIN_FILENO,
+         sink_t stdoutSink = nullptr, sink_t stderrSink = nullptr);   // stdinAs is the child's descriptor number for the input pipe
+    virtual ~exec ();
 
     bool                                 isTerminate(seconds waitFor = 0s) const;
-    int                                  exitCode() { exitCodeTask.wait(); return exitCodeTask.get(); };
+    int                                  exitCode() { return exitCodeTask.get(); };
 
     void                                 sendBuffer(const std::string& data, bool close = true);    // To send to the child's STDIN
-    const std::string&                   getOutput() const { return outputBuffer; };   // Need to fix this, only ok AFTER the child exited due to race condition
-    const std::string&                   getError() const { return errorBuffer; };   // Need to fix this, only ok AFTER the child exited due to race condition
+    const std::string&                   getOutput() const { exitCodeTask.wait(); return outputBuffer; };   // Waits for the child to complete
+    const std::string&                   getError() const { exitCodeTask.wait(); return errorBuffer; };
 
     void                                 clearBuffer();
   private:
@@ -74,24 +84,24 @@ namespace launch {
     int                                  inputPipe = -1;     // To connect to the child's STDIN
     int                                  outputPipe = -1;    // To connect to the chidl's STDOUT
     int                                  errorPipe = -1;     // To connect to the chidl's STDERR
+    int                                  wakeEvent = -1;     // eventfd, new data to send to the child
 
     std::string                          outputBuffer;       // From child's STDOUT
     std::string                          errorBuffer;        // From child's STDERR
+    sink_t                               outputSink;
+    sink_t                               errorSink;
 
-    int                                  execute(const cmdLine_t& cmdline, int intFD, int outFD, int errFD);
+    int                                  execute(const cmdLine_t& cmdline, int intFD, int outFD, int errFD, int intAs);
     pid_t                                pid = 0;
-    std::future<int>                     exitCodeTask;
-
-    void                                 serviceInputPipe();
-    std::future<void>                    stdinTask;
-    std::atomic<bool>                    mustClose;
-    std::string                          inputBuffer;
-    mutable std::recursive_mutex         _mutex;
-
-    void                                 serviceOutputPipe(bool stderr = false);
-    std::future<void>                    captureStdoutTask;
-    std::future<void>                    captureStderrTask;
-    mutable std::recursive_mutex         _mutexOutput;
+    std::shared_future<int>              exitCodeTask;
+
+    bool                                 serviceInputPipe();
+    static ssize_t                       writeNoSignal(int fd, const void* data, std::size_t size);
+    bool                                 serviceOutputPipe(int fd, std::string& buffer, const sink_t& sink);
+    int                                  reap(int pidFD);
+    bool                                 mustClose = false;
+    std::string                          inputBuffer;        // Pending data for the child's STDIN, shared with sendBuffer()
+    std::mutex                           _mutex;
 
     int                                  getCurrentPipeSpace(int pipe) { return fcntl(pipe, F_GETPIPE_SZ); };
 
@@ -15,6 +15,19 @@
  */
 #include "log.h"
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+
+#include <fcntl.h>
+#include <errno.h>
+
 namespace logger {
 
   bool                     ISDEBUG = false;
@@ -25,4 +38,259 @@ namespace logger {
 
   std::string              PREFIX = "Latchy - ";
 
+  namespace {
+    using clock_t =        std::chrono::system_clock;
+
+    struct entry {
+      clock_t::time_point  time;
+      level                lvl = level::user;
+      int                  target = STDERR_FILENO;     // -1 for the log file
+      std::string          asset;
+      std::string          text;
+      std::string          file;                       // Log file, when target is -1
+    };
+
+    // Single producer (the owning thread), single consumer (the writer)
+    struct ring {
+      static constexpr std::size_t    capacity = 1024;
+      std::array<entry, capacity>     slots;
+      std::atomic<std::size_t>        head = 0;        // Next slot written by the producer
+      std::atomic<std::size_t>        tail = 0;        // Next slot read by the writer
+      std::atomic<bool>               retired = false; // The thread ended, removed once drained
+    };
+
+    std::atomic<bool>      down = false;               // The writer is gone (static destruction), write directly
+
+    void writeAll(int fd, const std::string& data) {
+      std::size_t          done = 0;
+      while (done < data.size()) {
+        ssize_t            n = write(fd, data.data() + done, data.size() - done);
+        if (n < 0) {
+          if (errno == EINTR) {
+            continue;
+          }
+          return;
+        }
+        done += n;
+      }
+    }
+
+    std::string format(const entry& item) {
+      // Plain user messages, unless tracing where every line says when, what and for which asset
+      std::string                       retval(PREFIX);
+      if ( (ISINFO == true) or (ISDEBUG == true) ) {
+        auto                            micros = std::chrono::duration_cast<std::chrono::microseconds>(item.time.time_since_epoch()).count();
+        std::time_t                     seconds = micros / 1000000;
+        struct tm                       utc;
+        char                            stamp[40];
+        gmtime_r(&seconds, &utc);
+        std::size_t                     length = strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", &utc);
+        snprintf(stamp + length, sizeof(stamp) - length, ".%06ldZ ", (long) (micros % 1000000));
+        retval += stamp;
+        retval += (item.lvl == level::debug) ? "DEBUG " : ((item.lvl == level::info) ? "INFO  " : "USER  ");
+        if (item.asset.empty() == false) {
+          retval += "[" + item.asset + "] ";
+        }
+      }
+      retval += item.text;
+      if ( (retval.empty() == false) and (retval.back() != '\n') ) {
+        retval.push_back('\n');
+      }
+      return retval;
+    }
+
+    class backend {
+    public:
+      backend(): writer([this]() { run(); }) {};
+      ~backend() {
+        stopping = true;
+        submitted.fetch_add(1);
+        submitted.notify_one();
+        writer.join();
+        down = true;
+        if (logFD >= 0) {
+          close(logFD);
+        }
+      };
+
+      std::shared_ptr<ring> attach() {
+        std::shared_ptr<ring>         retval = std::make_shared<ring>();
+        std::scoped_lock              lock(registryMutex);
+        rings.push_back(retval);
+        return retval;
+      };
+
+      void push(ring& queue, entry&& item) {
+        std::size_t                   head = queue.head.load(std::memory_order_relaxed);
+        while (head - queue.tail.load(std::memory_order_acquire) == ring::capacity) {
+          // Full, the writer is behind. Nothing is dropped, we wait for room
+          submitted.notify_one();
+          std::this_thread::yield();
+        }
+        queue.slots[head % ring::capacity] = std::move(item);
+        queue.head.store(head + 1, std::memory_order_release);
+
+        submitted.fetch_add(1, std::memory_order_release);
+        submitted.notify_one();
+      };
+
+      void flush() {
+        std::uint64_t                 target = submitted.load();
+        std::uint64_t                 current;
+        while ( (down == false) and ((current = written.load()) < target) ) {
+          written.wait(current);
+        }
+      };
+
+    private:
+      std::mutex                      registryMutex;
+      std::vector<std::shared_ptr<ring>>  rings;
+      std::atomic<std::uint64_t>      submitted = 0;
+      std::atomic<std::uint64_t>      written = 0;
+      std::atomic<bool>               stopping = false;
+      int                             logFD = -1;
+      std::string                     logPath;
+      std::thread                     writer;         // Last, started once everything else is ready
+
+      void run() {
+        std::vector<entry>            batch;
+        while (true) {
+          std::uint64_t               seen = submitted.load(std::memory_order_acquire);
+          drain(batch);
+          if (batch.empty() == false) {
+            // Per thread order is preserved, across threads the timestamps decide
+            std::stable_sort(batch.begin(), batch.end(), [](const entry& a, const entry& b) { return a.time < b.time; });
+            for (const auto& item : batch) {
+              output(item);
+            }
+            written.fetch_add(batch.size());
+            written.notify_all();
+            batch.clear();
+            continue;
+          }
+
+          if (stopping == true) {
+            written.store(submitted.load());    // The stop request itself is not a line
+            written.notify_all();
+            return;
+          }
+          submitted.wait(seen, std::memory_order_acquire);
+        }
+      };
+
+      void drain(std::vector<entry>& batch) {
+        std::scoped_lock              lock(registryMutex);
+        for (auto queue = rings.begin(); queue != rings.end();) {
+          std::size_t                 tail = (*queue)->tail.load(std::memory_order_relaxed);
+          std::size_t                 head = (*queue)->head.load(std::memory_order_acquire);
+          for (; tail != head; ++tail) {
+            batch.push_back(std::move((*queue)->slots[tail % ring::capacity]));
+          }
+          (*queue)->tail.store(tail, std::memory_order_release);
+
+          if ( ((*queue)->retired == true) and ((*queue)->head.load(std::memory_order_acquire) == tail) ) {
+            queue = rings.erase(queue);
+          } else {
+            ++queue;
+          }
+        }
+      };
+
+      void output(const entry& item) {
+        if (item.target < 0) {
+          if ( (logFD < 0) or (logPath != item.file) ) {
+            if (logFD >= 0) {
+              close(logFD);
+            }
+            logPath = item.file;
+            logFD = open(logPath.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+          }
+          if (logFD >= 0) {
+            writeAll(logFD, item.text);
+          }
+          return;
+        }
+
+        writeAll(item.target, format(item));
+      };
+    };
+
+    backend& instance() {
+      static backend                  single;
+      return single;
+    }
+
+    // The thread's queue, retired when the thread ends
+    struct localRing {
+      std::shared_ptr<ring>           queue = instance().attach();
+      ~localRing() { queue->retired = true; };
+    };
+
+    thread_local std::ostringstream   localStream;
+    thread_local bool                 localStreamBusy = false;
+    thread_local std::string          currentAsset;
+
+    void submit(entry&& item) {
+      if (down == true) {
+        writeAll(item.target < 0 ? STDERR_FILENO : item.target, (item.target < 0) ? item.text : PREFIX + item.text);
+        return;
+      }
+      thread_local localRing          local;
+      instance().push(*local.queue, std::move(item));
+    }
+  } // namespace
+
+  line::line(level l): lvl(l) {
+    if (localStreamBusy == false) {
+      localStreamBusy = true;
+      stream = &localStream;
+    } else {
+      own = std::make_unique<std::ostringstream>();
+      stream = own.get();
+    }
+  }
+
+  line::~line() {
+    entry                             item;
+    item.time = clock_t::now();
+    item.lvl = lvl;
+    item.target = (USESTDERR == false) ? STDOUT_FILENO : STDERR_FILENO;
+    item.asset = currentAsset;
+    item.text = stream->str();
+
+    if (own == nullptr) {
+      localStream.str("");
+      localStream.clear();
+      localStream.copyfmt(std::ios(nullptr));   // Manipulators such as std::hex do not leak to the next line
+      localStreamBusy = false;
+    }
+
+    if (item.text.empty() == false) {
+      submit(std::move(item));
+    }
+  }
+
+  context::context(const std::string& assetId): previous(std::move(currentAsset)) {
+    currentAsset = assetId;
+  }
+
+  context::~context() {
+    currentAsset = std::move(previous);
+  }
+
+  void toFile(const std::string& text) {
+    entry                             item;
+    item.time = clock_t::now();
+    item.target = -1;
+    item.text = text;
+    item.file = LOGFILE.string();
+    submit(std::move(item));
+  }
+
+  void flush() {
+    if (down == false) {
+      instance().flush();
+    }
+  }
+
 } // namespace logger
@@ -16,9 +16,21 @@
 #pragma once
 
 #include <iostream>
+#include <sstream>
+#include <memory>
+#include <string>
 #include <unistd.h>
 #include "fileAccess.h"
 
+/// Logging
+///
+/// Each DEBUG() / INFO() / USERMSG() statement builds one line, which is handed as a whole to a background
+/// writer at the end of the statement. Lines from different threads never interleave and the calling thread
+/// never waits for the terminal or the log file. Each thread has its own lock-free queue, the writer merges
+/// them in time order. With --trace / --debug, lines carry a timestamp, their level and the asset being
+/// worked on (see logger::context).
+///
+/// A disabled level costs a single test of its flag, nothing is formatted.
 namespace logger {
 
   // Enable disable
@@ -30,22 +42,52 @@ namespace logger {
   extern std::filesystem::path    LOGFILE;
   extern std::string              PREFIX;   // Prefix added in fron of each line, usually set to application name
 
+  enum class level { user, info, debug };
+
+  class line {
+  public:
+    line(level l);
+    line(const line&) = delete;
+    ~line();                        // Queues the line
+
+    template <typename T>
+    line&                         operator<<(const T& value) { *stream << value; return *this; };
+    line&                         operator<<(std::ostream& (*manipulator)(std::ostream&)) { manipulator(*stream); return *this; };   // std::endl and co
+    line&                         operator<<(std::ios_base& (*manipulator)(std::ios_base&)) { manipulator(*stream); return *this; }; // std::hex and co
+
+  private:
+    level                         lvl;
+    std::ostringstream*           stream;
+    std::unique_ptr<std::ostringstream>   own;    // Only when the thread's stream is already in use (nested logging)
+  };
+
+  // Names the asset the current thread works on, for the lines it logs while the object lives
+  class context {
+  public:
+    context(const std::string& assetId);
+    ~context();
+  private:
+    std::string                   previous;
+  };
+
+  void                            toFile(const std::string& text);    // Appended to LOGFILE, which stays open
+  void                            flush();                            // Returns once every line queued so far is written
+
 // Unconditionally send an output to stdout
 #define USERCOUT() std::cout
 
 // Unconditionally send an output to stdout or stderr
-#define USERMSG() ((false == logger::USESTDERR) ? std::cout << logger::PREFIX : std::cerr << logger::PREFIX)
+#define USERMSG() logger::line(logger::level::user)
 
 // Log to file if LOGFILE is not empty
-#define LOGTOFILE(m) if (false == logger::LOGFILE.empty()) helpers::fileAccess::writeTo(logger::LOGFILE, logger::PREFIX + m, true)
+#define LOGTOFILE(m) if (false == logger::LOGFILE.empty()) logger::toFile(logger::PREFIX + m)
 
 // Conditionally output if ISDEBUG is true. 
-#define DEBUG() if (true == logger::ISDEBUG) ((false == logger::USESTDERR) ? std::cout << logger::PREFIX : std::cerr << logger::PREFIX)
+#define DEBUG() if (true == logger::ISDEBUG) logger::line(logger::level::debug)
 // Conditionally output if ISINFO is true. 
-#define INFO() if (true == logger::ISINFO) ((false == logger::USESTDERR) ? std::cout << logger::PREFIX : std::cerr << logger::PREFIX )
+#define INFO() if (true == logger::ISINFO) logger::line(logger::level::info)
 
 // Set the logfile to something in /tmp
 #define ACTIVATELOG() logger::LOGFILE = "/tmp/latchy." + std::to_string(getpid()) + ".log";
 
 } // namespace logger
-
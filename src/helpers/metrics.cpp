@@ -0,0 +1,388 @@
+/*
+ * Copyright 2024 NearEDGE, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "metrics.h"
+#include "log.h"
+#include "fileAccess.h"
+
+#include <set>
+#include <map>
+#include <deque>
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+namespace metrics {
+
+  namespace {
+    constexpr std::size_t             maxSpans = 256;         // Per timeline. A Tang retried for hours would otherwise grow forever
+    constexpr std::size_t             maxCompleted = 64;      // Completed timelines kept in full
+
+    // Upper bounds of the histogram buckets, in seconds. A Tang round trip on a LAN is in the first ones, an
+    // unreachable Tang or a reader that never comes in the last ones.
+    constexpr std::array<double, 14>  bucketBounds = { 0.001, 0.005, 0.01, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60, 300 };
+
+    struct histogram {
+      std::array<std::uint64_t, bucketBounds.size()>   buckets{};   // Not cumulative, see toPrometheus()
+      std::uint64_t                   count = 0;
+      double                          sum = 0;
+
+      void observe(double value) {
+        for (std::size_t i = 0; i < bucketBounds.size(); ++i) {
+          if (value <= bucketBounds[i]) {
+            ++buckets[i];
+            break;
+          }
+        }
+        ++count;
+        sum += value;
+      }
+    };
+
+    struct registry {
+      std::mutex                      access;
+      std::set<const timeline*>       live;
+      std::deque<timeline::summary>   completed;
+      std::array<histogram, stageCount>   stages;
+      std::uint64_t                   assets = 0;
+      std::uint64_t                   created = 0;      // Timeline ids
+      std::uint64_t                   retries = 0;
+      std::map<std::pair<std::string, std::string>, std::uint64_t>   responses;   // (server, code) -> count
+    };
+
+    // Never destroyed, timelines may well outlive any static object
+    registry& instance() {
+      static registry*                r = new registry;
+      return *r;
+    }
+
+    double seconds(clock_t::duration d) {
+      return std::chrono::duration<double>(d).count();
+    }
+
+    std::string number(double value) {
+      std::ostringstream              o;
+      o << std::fixed << std::setprecision(6) << value;
+      return o.str();
+    }
+
+    std::string promLabel(const std::string& value) {
+      std::string                     retval;
+      for (char c : value) {
+        switch (c) {
+          case '\\': retval += "\\\\"; break;
+          case '"':  retval += "\\\""; break;
+          case '\n': retval += "\\n";  break;
+          default:   retval += c;
+        }
+      }
+      return retval;
+    }
+
+    std::string jsonString(const std::string& value) {
+      std::string                     retval("\"");
+      for (unsigned char c : value) {
+        if ( (c == '"') or (c == '\\') ) {
+          retval += '\\';
+          retval += (char) c;
+        } else if (c < 0x20) {
+          char                        escaped[8];
+          snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+          retval += escaped;
+        } else {
+          retval += (char) c;
+        }
+      }
+      return retval + "\"";
+    }
+
+    // Live timelines first, then the completed ones. The registry must be locked
+    std::vector<timeline::summary> collect(registry& r) {
+      std::vector<timeline::summary>  retval;
+      for (const auto* t : r.live) {
+        retval.push_back(t->snapshot());
+      }
+      retval.insert(retval.end(), r.completed.begin(), r.completed.end());
+      return retval;
+    }
+  }
+
+  const char* stageName(stage s) {
+    switch (s) {
+      case stage::readInput:      return "read_input";
+      case stage::validate:       return "validate";
+      case stage::metadata:       return "metadata";
+      case stage::tangQueue:      return "tang_queue";
+      case stage::keyGeneration:  return "key_generation";
+      case stage::tangExchange:   return "tang_exchange";
+      case stage::retryWait:      return "retry_wait";
+      case stage::decryption:     return "decryption";
+      case stage::waitSecret:     return "wait_secret";
+      case stage::waitReader:     return "wait_reader";
+      case stage::delivery:       return "delivery";
+      case stage::linger:         return "linger";
+      default:                    return "unknown";
+    }
+  }
+
+  //
+  // timeline
+  //
+  timeline::timeline() {
+    registry&                         r = instance();
+    std::scoped_lock                  lock(r.access);
+    id = ++r.created;
+    r.live.insert(this);
+  }
+
+  timeline::~timeline() {
+    registry&                         r = instance();
+    std::scoped_lock                  lock(r.access);
+    r.live.erase(this);
+
+    // An asset that never did anything (dump mode, configuration error) is left out
+    summary                           done = snapshot(true);
+    if (done.spans.empty() == true) {
+      return;
+    }
+
+    for (const auto& s : done.spans) {
+      r.stages[static_cast<std::size_t>(s.what)].observe(seconds(s.duration));
+    }
+    ++r.assets;
+    r.retries += done.retries;
+
+    r.completed.push_back(std::move(done));
+    if (r.completed.size() > maxCompleted) {
+      r.completed.pop_front();
+    }
+  }
+
+  void timeline::label(const std::string& n) {
+    std::scoped_lock                  lock(access);
+    if (name.empty() == true) {
+      name = n;
+    }
+  }
+
+  void timeline::record(stage s, clock_t::time_point begin, clock_t::time_point end) {
+    std::scoped_lock                  lock(access);
+    totals[static_cast<std::size_t>(s)] += end - begin;
+    if (spans.size() < maxSpans) {
+      spans.push_back({ s, begin - created, end - begin });
+    }
+  }
+
+  void timeline::retry() {
+    std::scoped_lock                  lock(access);
+    ++retries;
+  }
+
+  timeline::summary timeline::snapshot(bool done) const {
+    std::scoped_lock                  lock(access);
+    summary                           retval;
+    retval.id = id;
+    retval.name = name.empty() ? "unnamed" : name;
+    retval.done = done;
+    retval.retries = retries;
+    retval.elapsed = clock_t::now() - created;
+    retval.totals = totals;
+    retval.spans = spans;
+    return retval;
+  }
+
+  //
+  // Process-wide counters
+  //
+  void tangResponse(const std::string& server, const std::string& code) {
+    registry&                         r = instance();
+    std::scoped_lock                  lock(r.access);
+    ++r.responses[{ server, code }];
+  }
+
+  //
+  // Export
+  //
+  std::string toPrometheus() {
+    registry&                         r = instance();
+    std::scoped_lock                  lock(r.access);
+    std::ostringstream                o;
+
+    o << "# HELP latchy_stage_duration_seconds Time spent in each unlock stage, by completed assets\n"
+      << "# TYPE latchy_stage_duration_seconds histogram\n";
+    for (std::size_t i = 0; i < stageCount; ++i) {
+      const std::string               name(stageName(static_cast<stage>(i)));
+      const histogram&                h = r.stages[i];
+      std::uint64_t                   cumulative = 0;
+      for (std::size_t b = 0; b < bucketBounds.size(); ++b) {
+        cumulative += h.buckets[b];
+        o << "latchy_stage_duration_seconds_bucket{stage=\"" << name << "\",le=\"" << bucketBounds[b] << "\"} " << cumulative << "\n";
+      }
+      o << "latchy_stage_duration_seconds_bucket{stage=\"" << name << "\",le=\"+Inf\"} " << h.count << "\n"
+        << "latchy_stage_duration_seconds_sum{stage=\"" << name << "\"} " << number(h.sum) << "\n"
+        << "latchy_stage_duration_seconds_count{stage=\"" << name << "\"} " << h.count << "\n";
+    }
+
+    o << "# HELP latchy_assets_completed_total Assets that went away, successfully or not\n"
+      << "# TYPE latchy_assets_completed_total counter\n"
+      << "latchy_assets_completed_total " << r.assets << "\n"
+      << "# HELP latchy_assets_in_flight Assets currently processed\n"
+      << "# TYPE latchy_assets_in_flight gauge\n"
+      << "latchy_assets_in_flight " << r.live.size() << "\n"
+      << "# HELP latchy_tang_retries_total Tang requests retried, by completed assets\n"
+      << "# TYPE latchy_tang_retries_total counter\n"
+      << "latchy_tang_retries_total " << r.retries << "\n";
+
+    o << "# HELP latchy_tang_responses_total Tang responses by server and HTTP status\n"
+      << "# TYPE latchy_tang_responses_total counter\n";
+    for (const auto& [key, count] : r.responses) {
+      o << "latchy_tang_responses_total{server=\"" << promLabel(key.first) << "\",code=\"" << promLabel(key.second) << "\"} " << count << "\n";
+    }
+
+    // Per asset, for the ones running and the last completed ones. Names repeat, the id keeps the series apart
+    std::vector<timeline::summary>    timelines = collect(r);
+    auto                              labels = [](const timeline::summary& t) {
+      return "asset=\"" + promLabel(t.name) + "\",id=\"" + std::to_string(t.id) + "\",done=\"" + (t.done ? "true" : "false") + "\"";
+    };
+    o << "# HELP latchy_asset_stage_seconds Time spent in each stage, by asset\n"
+      << "# TYPE latchy_asset_stage_seconds gauge\n";
+    for (const auto& t : timelines) {
+      for (std::size_t i = 0; i < stageCount; ++i) {
+        if (t.totals[i] != clock_t::duration::zero()) {
+          o << "latchy_asset_stage_seconds{" << labels(t) << ",stage=\"" << stageName(static_cast<stage>(i)) << "\"} " << number(seconds(t.totals[i])) << "\n";
+        }
+      }
+    }
+    o << "# HELP latchy_asset_retries Tang requests retried, by asset\n"
+      << "# TYPE latchy_asset_retries gauge\n";
+    for (const auto& t : timelines) {
+      o << "latchy_asset_retries{" << labels(t) << "} " << t.retries << "\n";
+    }
+
+    return o.str();
+  }
+
+  std::string toJson() {
+    registry&                         r = instance();
+    std::scoped_lock                  lock(r.access);
+    std::ostringstream                o;
+
+    o << "{\"assetsCompleted\":" << r.assets << ",\"assetsInFlight\":" << r.live.size() << ",\"tangRetries\":" << r.retries;
+
+    o << ",\"stages\":{";
+    for (std::size_t i = 0; i < stageCount; ++i) {
+      const histogram&                h = r.stages[i];
+      o << ((i == 0) ? "" : ",") << jsonString(stageName(static_cast<stage>(i))) << ":{\"count\":" << h.count << ",\"sum\":" << number(h.sum) << ",\"buckets\":[";
+      for (std::size_t b = 0; b < bucketBounds.size(); ++b) {
+        o << ((b == 0) ? "" : ",") << "{\"le\":" << bucketBounds[b] << ",\"count\":" << h.buckets[b] << "}";
+      }
+      o << "]}";
+    }
+    o << "}";
+
+    o << ",\"tangResponses\":[";
+    bool                              first = true;
+    for (const auto& [key, count] : r.responses) {
+      o << (first ? "" : ",") << "{\"server\":" << jsonString(key.first) << ",\"code\":" << jsonString(key.second) << ",\"count\":" << count << "}";
+      first = false;
+    }
+    o << "]";
+
+    o << ",\"assets\":[";
+    first = true;
+    for (const auto& t : collect(r)) {
+      o << (first ? "" : ",") << "{\"id\":" << t.id << ",\"asset\":" << jsonString(t.name) << ",\"done\":" << (t.done ? "true" : "false")
+        << ",\"elapsed\":" << number(seconds(t.elapsed)) << ",\"retries\":" << t.retries << ",\"spans\":[";
+      for (std::size_t s = 0; s < t.spans.size(); ++s) {
+        o << ((s == 0) ? "" : ",") << "{\"stage\":" << jsonString(stageName(t.spans[s].what)) << ",\"start\":" << number(seconds(t.spans[s].start))
+          << ",\"duration\":" << number(seconds(t.spans[s].duration)) << "}";
+      }
+      o << "]}";
+      first = false;
+    }
+    o << "]}\n";
+
+    return o.str();
+  }
+
+  void exportTo(const std::filesystem::path& file) {
+    std::string                       content = (file.extension() == ".json") ? toJson() : toPrometheus();
+
+    // Written aside and renamed, a collector never sees half of it
+    std::filesystem::path             pending(file.string() + ".tmp");
+    int                               descriptor = open(pending.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (descriptor < 0) {
+      throw helpers::fileAccess::canNotOpen(pending, true);
+    }
+
+    std::size_t                       writtenSoFar = 0;
+    while (writtenSoFar < content.size()) {
+      ssize_t                         retval = write(descriptor, content.data() + writtenSoFar, content.size() - writtenSoFar);
+      if (retval < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        std::string                   reason(strerror(errno));
+        close(descriptor);
+        unlink(pending.c_str());
+        throw helpers::fileAccess::error("Can not write the metrics to " + pending.string() + " - " + reason);
+      }
+      writtenSoFar += retval;
+    }
+    close(descriptor);
+
+    std::filesystem::rename(pending, file);
+  }
+
+  //
+  // exporter
+  //
+  exporter::exporter(const std::filesystem::path& f, std::chrono::seconds i): file(f), interval(i) {
+    if ( (file.empty() == true) or (interval == std::chrono::seconds::zero()) ) {
+      return;
+    }
+
+    exportTask = std::async(std::launch::async, [this, stop = stopPromise.get_future()]() {
+      while (stop.wait_for(interval) == std::future_status::timeout) {
+        try {
+          exportTo(file);
+        } catch (std::exception& exc) {
+          USERMSG() << "Failed to export the metrics - " << exc.what() << std::endl;
+        }
+      }
+    });
+  }
+
+  exporter::~exporter() {
+    if (exportTask.valid() == true) {
+      stopPromise.set_value();
+      exportTask.wait();
+    }
+
+    if (file.empty() == false) {
+      try {
+        exportTo(file);
+        INFO() << "Metrics exported to " << file.string() << std::endl;
+      } catch (std::exception& exc) {
+        USERMSG() << "Failed to export the metrics - " << exc.what() << std::endl;
+      }
+    }
+  }
+
+} // namespace metrics
@@ -0,0 +1,131 @@
+/*
+ * Copyright 2024 NearEDGE, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <array>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <future>
+#include <chrono>
+#include <filesystem>
+
+/// Latency metrics
+///
+/// Each asset owns a timeline. The source and the provider open a span (see metrics::span) around every stage
+/// an asset goes through, from reading the JWE to the client consuming the secret. Spans use the monotonic
+/// clock. A timeline is folded into process-wide histograms when its asset goes away, the last completed
+/// timelines are kept in full for inspection.
+///
+/// The whole lot is exported, at exit and periodically, either as a Prometheus textfile (for the node exporter
+/// textfile collector) or as JSON, depending on the file extension.
+namespace metrics {
+  using clock_t =                       std::chrono::steady_clock;
+
+  enum class stage {
+    readInput,                          // Reading the JWE (file, named pipe or STDIN)
+    validate,                           // Decomposing and checking the JWE
+    metadata,                           // Waiting for the process metadata, for the Tang query string
+    tangQueue,                          // Waiting for the Tang server to admit the request (maxInFlight)
+    keyGeneration,                      // Ephemeral key and key exchanges
+    tangExchange,                       // One request to the Tang server
+    retryWait,                          // Back off between two Tang requests
+    decryption,                         // Unwrapping the payload
+    waitSecret,                         // Provider waiting for its source
+    waitReader,                         // Provider waiting for the client (open, or consumption of a file)
+    delivery,                           // Writing the secret out
+    linger,                             // Monitoring the output once done (see assetProvider::stop())
+    count
+  };
+  constexpr std::size_t                 stageCount = static_cast<std::size_t>(stage::count);
+  const char*                           stageName(stage s);
+
+  class timeline {
+  public:
+    timeline();
+    timeline(const timeline&) = delete;
+    ~timeline();                        // Folds the spans into the process-wide histograms
+
+    void                                label(const std::string& name);     // The first name given sticks
+    void                                record(stage s, clock_t::time_point begin, clock_t::time_point end);
+    void                                retry();
+
+    struct spanRecord {
+      stage                             what;
+      clock_t::duration                 start;        // Since the timeline was created
+      clock_t::duration                 duration;
+    };
+
+    struct summary {
+      std::uint64_t                     id = 0;       // Unique in the process, names are not (agent requests, shared inputs)
+      std::string                       name;
+      bool                              done = false;
+      std::size_t                       retries = 0;
+      clock_t::duration                 elapsed{};
+      std::array<clock_t::duration, stageCount>   totals{};
+      std::vector<spanRecord>           spans;
+    };
+    summary                             snapshot(bool done = false) const;
+
+  private:
+    mutable std::mutex                  access;
+    std::uint64_t                       id = 0;
+    std::string                         name;
+    clock_t::time_point                 created = clock_t::now();
+    std::size_t                         retries = 0;
+    std::array<clock_t::duration, stageCount>   totals{};
+    std::vector<spanRecord>             spans;        // Bounded, the totals keep counting
+  };
+  using timeline_p =                    std::shared_ptr<timeline>;
+
+  /// Measures one stage, from construction to close() or destruction. A null timeline makes it a no-op.
+  class span {
+  public:
+    span(const timeline_p& t, stage s): owner(t.get()), what(s) { };
+    span(const span&) = delete;
+    ~span() { close(); };
+
+    void                                close() { if (owner != nullptr) { owner->record(what, begin, clock_t::now()); owner = nullptr; } };
+
+  private:
+    timeline*                           owner;
+    stage                               what;
+    clock_t::time_point                 begin = clock_t::now();
+  };
+
+  void                                  tangResponse(const std::string& server, const std::string& code);   // HTTP status, "none" when no response came
+
+  std::string                           toPrometheus();
+  std::string                           toJson();
+  void                                  exportTo(const std::filesystem::path& file);     // .json is JSON, anything else the Prometheus text format
+
+  /// Exports to a file every interval (0 to only export at the end) and once more when destroyed. An empty
+  /// path disables it.
+  class exporter {
+  public:
+    exporter(const std::filesystem::path& file, std::chrono::seconds interval);
+    ~exporter();
+
+  private:
+    std::filesystem::path               file;
+    std::chrono::seconds                interval;
+    std::promise<void>                  stopPromise;
+    std::future<void>                   exportTask;
+  };
+
+} // namespace metrics
@@ -0,0 +1,56 @@
+/*
+ * Copyright 2024 NearEDGE, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+/// Static tracepoints (USDT), provider "latchy"
+///
+/// A probe is a single nop in the binary plus an ELF note, it costs nothing until bpftrace or perf attaches to
+/// it. Arguments are asset ids (file or pipe names, Tang URLs) and sizes, never secret material.
+///
+///   tang__start(url, requestSize)                     keyRecoverViaTang, before the request
+///   tang__done(url, httpStatus, responseSize)         keyRecoverViaTang, 0 when no response, -1 when unparsable
+///   tang__retry(asset, retries, delayMs)              recoverPrivateKey, the request is retried after delayMs
+///   circuit__change(url, state)                       keyRecoverViaTang, 0 closed, 1 open, 2 half open (probing)
+///   decrypt__start(asset, jweSize)                    recoverPayload
+///   decrypt__done(asset, secretSize)
+///   fifo__open(asset)                                 prepareFifo, a reader opened the named pipe
+///   deliver__first(asset, bytes)                      deliverDataToFifo / writeToRegularFile, first write
+///   inotify__event(asset, mask)                       monitorFileConsumption
+///
+/// For example
+///
+///   bpftrace -e 'usdt:/usr/bin/latchy:latchy:tang__start { @s[tid] = nsecs; }
+///                usdt:/usr/bin/latchy:latchy:tang__done /@s[tid]/ { @rtt = hist((nsecs - @s[tid]) / 1000); delete(@s[tid]); }'
+///
+/// Without <sys/sdt.h> (or with -DLATCHY_NO_USDT) the probes compile to nothing and their arguments are not
+/// evaluated.
+
+#if !defined(LATCHY_NO_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define LATCHY_HAS_USDT 1
+#endif
+#endif
+
+#if defined(LATCHY_HAS_USDT)
+#define LATCHY_PROBE1(name, a)          DTRACE_PROBE1(latchy, name, a)
+#define LATCHY_PROBE2(name, a, b)       DTRACE_PROBE2(latchy, name, a, b)
+#define LATCHY_PROBE3(name, a, b, c)    DTRACE_PROBE3(latchy, name, a, b, c)
+#else
+#define LATCHY_PROBE1(name, a)          do {} while (0)
+#define LATCHY_PROBE2(name, a, b)       do {} while (0)
+#define LATCHY_PROBE3(name, a, b, c)    do {} while (0)
+#endif
@@ -0,0 +1,129 @@
+/*
+ * Copyright 2024 NearEDGE, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "startup.h"
+#include "fileAccess.h"
+#include "stringSplit.h"
+
+#include <array>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+
+#include <time.h>
+#include <unistd.h>
+
+namespace startup {
+
+  namespace {
+    using clock_t =                     std::chrono::steady_clock;
+
+    struct milestone {
+      const char*                       name = nullptr;
+      clock_t::time_point               when;
+    };
+
+    std::atomic<bool>                   enabled = false;
+    std::atomic<bool>                   reported = false;
+    std::mutex                          access;
+    std::array<milestone, 32>           milestones;     // Far more than there are
+    std::size_t                         count = 0;
+
+    // Seconds since boot, CLOCK_BOOTTIME being the clock of the process start time in /proc/self/stat
+    double bootTime() {
+      struct timespec                   now;
+      clock_gettime(CLOCK_BOOTTIME, &now);
+      return now.tv_sec + now.tv_nsec / 1e9;
+    }
+
+    // exec to static initialisation, in ms. /proc only knows the start time in clock ticks, so this is coarse.
+    // Negative when unknown
+    double execToStart(double bootAtStart) {
+      std::string                       stat;
+      if (helpers::fileAccess::readFile("/proc/self/stat", stat, true) != std::error_code()) {
+        return -1;
+      }
+      // The command name may hold spaces, the fields we want come after its closing parenthesis
+      std::size_t                       nameEnd = stat.rfind(')');
+      if (nameEnd == std::string::npos) {
+        return -1;
+      }
+      auto                              fields = misc::split(stat.substr(nameEnd + 2), ' ');
+      constexpr std::size_t             startTimeField = 22 - 3;    // Field 22 of proc(5), counting from the state (3)
+      if (fields.size() <= startTimeField) {
+        return -1;
+      }
+      const double                      started = std::stod(fields[startTimeField]) / sysconf(_SC_CLK_TCK);
+      return std::max(0.0, (bootAtStart - started) * 1000);
+    }
+
+    // Taken during the static initialisation, as close to exec as we get
+    const clock_t::time_point           processStart = clock_t::now();
+    const double                        bootAtStart = bootTime();
+  }
+
+  void enable() {
+    enabled = true;
+  }
+
+  void mark(const char* name) {
+    const clock_t::time_point           now = clock_t::now();
+    std::lock_guard<std::mutex>         lock(access);
+    for (std::size_t i = 0; i < count; ++i) {
+      if (std::strcmp(milestones[i].name, name) == 0) {
+        return;
+      }
+    }
+    if (count < milestones.size()) {
+      milestones[count++] = { name, now };
+    }
+  }
+
+  void report() {
+    if ( (enabled == false) or (reported.exchange(true) == true) ) {
+      return;
+    }
+
+    std::array<milestone, 32>           sorted;
+    std::size_t                         reached = 0;
+    {
+      std::lock_guard<std::mutex>       lock(access);
+      sorted = milestones;
+      reached = count;
+    }
+    // The background milestones come in any order
+    std::sort(sorted.begin(), sorted.begin() + reached, [](const milestone& a, const milestone& b) { return a.when < b.when; });
+
+    auto                                ms = [](clock_t::duration d) { return std::chrono::duration<double, std::milli>(d).count(); };
+    const double                        beforeStart = execToStart(bootAtStart);
+    // Always on stderr, stdout may be carrying a secret. Written at once so that other threads do not cut in
+    std::ostringstream                  out;
+    out << "Startup timing, ms since the process initialisation (exec to initialisation ~"
+        << ((beforeStart < 0) ? std::string("?") : std::to_string(static_cast<long>(beforeStart))) << " ms)" << std::endl;
+    clock_t::time_point                 previous = processStart;
+    for (std::size_t i = 0; i < reached; ++i) {
+      out << std::fixed << std::setprecision(2) << std::setw(10) << ms(sorted[i].when - processStart)
+          << "  +" << std::setw(8) << std::left << ms(sorted[i].when - previous) << std::right << "  " << sorted[i].name << std::endl;
+      previous = sorted[i].when;
+    }
+    std::cerr << out.str() << std::flush;
+  }
+
+} // namespace startup
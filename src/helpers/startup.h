@@ -0,0 +1,30 @@
+/*
+ * Copyright 2024 NearEDGE, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+/// Startup timing
+///
+/// Milestones of the way from exec to the first Tang request: command line, input, configuration, assets,
+/// and the subsystems readied in the background (libcurl / OpenSSL, process metadata). Each milestone is
+/// recorded once, the first time it is reached, relative to the static initialisation of the process.
+///
+/// The breakdown is printed (on stderr) once, at the first Tang request or at exit, when enabled with
+/// --startup-timing or the LATCHY_STARTUP_TIMING environment variable (the implicit mode takes no arguments).
+namespace startup {
+  void                                  enable();
+  void                                  mark(const char* milestone);    // A string literal, only the first call counts
+  void                                  report();                       // Once, and only when enabled
+} // namespace startup
@@ -0,0 +1,147 @@
+/*
+ * Copyright 2024 NearEDGE, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "unixSocket.h"
+#include "log.h"
+
+#include <cstring>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+
+namespace helpers {
+namespace unixSocket {
+  using namespace std::string_literals;
+
+int listenOn(const std::filesystem::path& path) {
+  struct sockaddr_un    address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (path.string().size() >= sizeof(address.sun_path)) {
+    throw error(path, "Path is too long");
+  }
+  strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+  // A left over socket from a previous run would prevent the bind
+  struct stat           status;
+  if ( (lstat(path.c_str(), &status) == 0) and (S_ISSOCK(status.st_mode)) ) {
+    unlink(path.c_str());
+  }
+
+  int                   descriptor = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (descriptor < 0) {
+    throw error(path, "Can not create the socket - "s + strerror(errno));
+  }
+
+  // Owner only, SO_PEERCRED does the rest. Not through the umask, which is process-wide and other threads create
+  // files too. On Linux bind() creates the node with the mode of the socket (less the umask), so there is no
+  // window where it is more open. The chmod afterwards covers the other systems
+  fchmod(descriptor, 0600);
+  if (bind(descriptor, (struct sockaddr*) &address, sizeof(address)) != 0) {
+    std::string         reason(strerror(errno));
+    close(descriptor);
+    throw error(path, "Can not bind - " + reason);
+  }
+  if (chmod(path.c_str(), 0600) != 0) {
+    std::string         reason(strerror(errno));
+    closeListener(descriptor, path);
+    throw error(path, "Can not restrict the socket to its owner - " + reason);
+  }
+
+  if (listen(descriptor, SOMAXCONN) != 0) {
+    std::string         reason(strerror(errno));
+    closeListener(descriptor, path);
+    throw error(path, "Can not listen - " + reason);
+  }
+
+  return descriptor;
+}
+
+void closeListener(int& descriptor, const std::filesystem::path& path) {
+  if (descriptor >= 0) {
+    close(descriptor);
+    descriptor = -1;
+    unlink(path.c_str());
+  }
+}
+
+int acceptPeer(int listenDescriptor, std::chrono::milliseconds timeout) {
+  struct pollfd         pending = { listenDescriptor, POLLIN, 0 };
+  if (poll(&pending, 1, timeout.count()) <= 0) {
+    return -1;    // Timeout, or an interrupt
+  }
+
+  int                   descriptor = accept4(listenDescriptor, nullptr, nullptr, SOCK_CLOEXEC);
+  if (descriptor < 0) {
+    DEBUG() << "Failed to accept a connection - " << strerror(errno) << std::endl;
+  }
+  return descriptor;
+}
+
+bool isAuthorized(int descriptor) {
+  struct ucred          credentials;
+  socklen_t             length = sizeof(credentials);
+
+  if (getsockopt(descriptor, SOL_SOCKET, SO_PEERCRED, &credentials, &length) != 0) {
+    USERMSG() << "Can not get the peer credentials, rejecting the client - " << strerror(errno) << std::endl;
+    return false;
+  }
+
+  INFO() << "Connection from pid " << credentials.pid << ", uid " << credentials.uid << ", gid " << credentials.gid << std::endl;
+  if ( (credentials.uid == 0) or (credentials.uid == geteuid()) ) {
+    return true;
+  }
+
+  USERMSG() << "Rejecting client with uid " << credentials.uid << " (pid " << credentials.pid << ")" << std::endl;
+  return false;
+}
+
+void sendDescriptor(int descriptor, int fd, const std::string& payload) {
+  // At least one byte of real data must go along with the ancillary data
+  std::string           data = payload.empty() ? std::string(1, '\0') : payload;
+  struct iovec          chunk = { data.data(), data.size() };
+  alignas(struct cmsghdr) char   control[CMSG_SPACE(sizeof(int))];
+  memset(control, 0, sizeof(control));
+
+  struct msghdr         message;
+  memset(&message, 0, sizeof(message));
+  message.msg_iov = &chunk;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+
+  struct cmsghdr*       header = CMSG_FIRSTHDR(&message);
+  header->cmsg_level = SOL_SOCKET;
+  header->cmsg_type = SCM_RIGHTS;
+  header->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(header), &fd, sizeof(int));
+
+  ssize_t               retval;
+  do {
+    retval = sendmsg(descriptor, &message, MSG_NOSIGNAL);
+  } while ( (retval < 0) and (errno == EINTR) );
+
+  if (retval < 0) {
+    throw std::runtime_error("Failed to hand over a descriptor - "s + strerror(errno));
+  }
+}
+
+} // namespace unixSocket
+} // namespace helpers
@@ -0,0 +1,39 @@
+/*
+ * Copyright 2024 NearEDGE, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <string>
+#include <stdexcept>
+#include <filesystem>
+#include <chrono>
+
+/// Small helpers around Unix domain sockets, shared by the agent and the socket egress.
+namespace helpers {
+namespace unixSocket {
+
+  int                            listenOn(const std::filesystem::path& path);     // Owner only socket, a stale socket at path is replaced
+  void                           closeListener(int& descriptor, const std::filesystem::path& path);
+  int                            acceptPeer(int listenDescriptor, std::chrono::milliseconds timeout);   // -1 when nobody showed up in time
+  bool                           isAuthorized(int descriptor);                     // SO_PEERCRED, only root and our own user are accepted
+  void                           sendDescriptor(int descriptor, int fd, const std::string& payload);   // SCM_RIGHTS
+
+  class error: public std::runtime_error {
+  public:
+    error(const std::filesystem::path& path, const std::string& msg): std::runtime_error("Socket error for " + path.string() + " - " + msg) {}
+  };
+
+} // namespace unixSocket
+} // namespace helpers
@@ -13,9 +13,12 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include "agent.h"
 #include "assets.h"
+#include "batch.h"
 #include "help.h"
 #include "helpers/log.h"
+#include "helpers/startup.h"
 #include "metaInfo/metaInfo.h"
 
 #include <memory>
@@ -24,15 +27,31 @@
 #include <stdexcept>
 #include <array>
 
+#include <atomic>
+#include <filesystem>
+#include <cstring>
+#include <csignal>
+
 #include <unistd.h>
 #include <getopt.h>
 #include <cstdlib>
+#include <limits.h>
+#include <poll.h>
+#include <sys/inotify.h>
 
 namespace latchy {
   using namespace std::chrono_literals;
   std::string     inputConfiguration;
+  bool            implicitInput = false;    // The default configuration, a JWE on stdin
+  std::filesystem::path   configurationFile;
+  bool            configurationCache = false;
+  std::string     agentSocket;
+  bool            batchMode = false;
+  std::size_t     batchWindow = 16;
   bool            compatibleMode = false;
   bool            dumpHeader = false;
+  std::filesystem::path   metricsFile;
+  std::chrono::seconds    metricsInterval = 60s;
 
   void processCommandLine(int argc, char** argv) {
     //
@@ -42,10 +61,18 @@ namespace latchy {
     //
     // -h, --help     Show the help content
     // -c, --cfg {}   JSON formatted configuration string
+    // --cfg-file F   JSON formatted configuration file, reloaded on SIGHUP or when it changes
+    // --cfg-cache    Keep the parsed configuration file in a binary sidecar (F.cache) for the next runs
     // -d, --debug    Enable DEBUG level output (stderr), does include INFO as well
     // -t, --trace    Enable INFO level output (to stderr)
     // --dump         Simply dump the protected header (to stderr)
     // --compatible   Do not include the query string. Typical tang servers won't accept it
+    // --agent PATH   Stay resident and serve unlock requests on the Unix socket PATH
+    // --batch        Bulk mode, newline delimited JWE (or JSON records) on stdin, results on stdout
+    // --window N     Number of records processed concurrently in batch mode
+    // --metrics F    Export the latency metrics to F at exit (Prometheus textfile, or JSON when F ends with .json)
+    // --metrics-interval N   Also export every N seconds, 0 for only at exit
+    // --startup-timing       Print the time taken by each startup step, up to the first Tang request
     //
     
     DEBUG() << "We found " << argc << " arguments, including the process filename." << std::endl;
@@ -59,14 +86,30 @@ namespace latchy {
 
     constexpr int OPTION_COMPATIBLE = 1000;
     constexpr int OPTION_DUMP = 1100;
+    constexpr int OPTION_AGENT = 1200;
+    constexpr int OPTION_BATCH = 1300;
+    constexpr int OPTION_WINDOW = 1310;
+    constexpr int OPTION_CFGFILE = 1400;
+    constexpr int OPTION_CFGCACHE = 1410;
+    constexpr int OPTION_METRICS = 1500;
+    constexpr int OPTION_METRICSINTERVAL = 1510;
+    constexpr int OPTION_STARTUPTIMING = 1600;
     std::string                       shortOptions("hc:");
-    std::array<struct option, 7>      longOptions{{
+    std::array<struct option, 15>     longOptions{{
       {"help", no_argument, nullptr, 'h'},
       {"cfg", required_argument, nullptr, 'c'},
+      {"cfg-file", required_argument, nullptr, OPTION_CFGFILE},
+      {"cfg-cache", no_argument, nullptr, OPTION_CFGCACHE},
       {"debug", no_argument, nullptr, 'd'},
       {"trace", no_argument, nullptr, 't'},
       {"compatible", no_argument, nullptr, OPTION_COMPATIBLE},
       {"dump", no_argument, nullptr, OPTION_DUMP},
+      {"agent", required_argument, nullptr, OPTION_AGENT},
+      {"batch", no_argument, nullptr, OPTION_BATCH},
+      {"window", required_argument, nullptr, OPTION_WINDOW},
+      {"metrics", required_argument, nullptr, OPTION_METRICS},
+      {"metrics-interval", required_argument, nullptr, OPTION_METRICSINTERVAL},
+      {"startup-timing", no_argument, nullptr, OPTION_STARTUPTIMING},
       {0, 0, 0, 0} },
     };
     while (1) {
@@ -118,6 +161,48 @@ namespace latchy {
         dumpHeader = true;
         break;
 
+      case OPTION_AGENT:
+        agentSocket = std::string(optarg);
+        break;
+
+      case OPTION_CFGFILE:
+        configurationFile = std::filesystem::absolute(optarg);
+        break;
+
+      case OPTION_CFGCACHE:
+        configurationCache = true;
+        break;
+
+      case OPTION_BATCH:
+        batchMode = true;
+        break;
+
+      case OPTION_WINDOW:
+        try {
+          batchWindow = std::stoul(optarg);
+        } catch (std::exception& exc) {
+          USERMSG() << "Invalid argument to option window - We bail out" << std::endl;
+          exit(-1);
+        }
+        break;
+
+      case OPTION_METRICS:
+        metricsFile = std::filesystem::absolute(optarg);
+        break;
+
+      case OPTION_METRICSINTERVAL:
+        try {
+          metricsInterval = std::chrono::seconds(std::stoul(optarg));
+        } catch (std::exception& exc) {
+          USERMSG() << "Invalid argument to option metrics-interval - We bail out" << std::endl;
+          exit(-1);
+        }
+        break;
+
+      case OPTION_STARTUPTIMING:
+        startup::enable();
+        break;
+
       default:
         USERMSG() << "Character was " << c << std::endl;
         USERMSG() << "Unexpected result when parsing the command line " << std::endl;
@@ -148,6 +233,7 @@ namespace latchy {
     } else if ( (c != '{') and ((c != '[') ) ) {
       // We presume a JWE so we assume the implicit mode. We simply prepare the default configuration as needed.
       cfg = R"({"secrets":[{"iMethod":"STDIN", "lockingMethod":"CLEVIS", "eMethod":"STDOUT"}]})";
+      implicitInput = true;     // run() builds this one without the JSON parser
     } else {
       // Explicit configuration from stdin. Lets get it!!
       std::stringstream               rdbuffer;
@@ -193,19 +279,94 @@ namespace latchy {
   return cfg;
 }
 
+  std::atomic<bool>   reloadRequested = false;
+
+  void reloadHandler(int) {
+    reloadRequested = true;
+  }
+
+  void superviseConfiguration(assets::list& assets) {
+    //
+    // Keep the assets in line with the configuration file until they all complete. A SIGHUP, or the file being
+    // rewritten (in place or by a rename, as most editors do), triggers a reload.
+    //
+    struct sigaction      action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = reloadHandler;
+    sigaction(SIGHUP, &action, nullptr);
+
+    int                   inotifyFD = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if ( (inotifyFD >= 0) and (inotify_add_watch(inotifyFD, configurationFile.parent_path().c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) ) {
+      close(inotifyFD);
+      inotifyFD = -1;
+    }
+    if (inotifyFD < 0) {
+      USERMSG() << "Can not watch " << configurationFile.string() << ", only SIGHUP triggers a reload - " << strerror(errno) << std::endl;
+    }
+
+    while (assets.isComplete((inotifyFD < 0) ? 250ms : 0ms) == false) {
+      if (inotifyFD >= 0) {
+        struct pollfd     ready = { inotifyFD, POLLIN, 0 };
+        if (poll(&ready, 1, 250) > 0) {
+          alignas(struct inotify_event) char   buffer[10*(sizeof(struct inotify_event) + NAME_MAX + 1)];
+          ssize_t         retval;
+          while ( (retval = read(inotifyFD, buffer, sizeof(buffer))) > 0 ) {
+            for (char* current = buffer; current < buffer + retval; ) {
+              struct inotify_event* event = reinterpret_cast<struct inotify_event*>(current);
+              if ( (event->len > 0) and (configurationFile.filename() == event->name) ) {
+                reloadRequested = true;
+              }
+              current += sizeof(struct inotify_event) + event->len;
+            }
+          }
+        }
+      }
+
+      if (reloadRequested.exchange(false) == true) {
+        INFO() << "Reloading the configuration from " << configurationFile.string() << std::endl;
+        try {
+          assets.reload(configuration::parseFileToMsg(configurationFile, configurationCache), compatibleMode);
+        } catch (std::exception& exc) {
+          // Keep going with what we have
+          USERMSG() << "Failed to reload the configuration, keeping the current one - " << exc.what() << std::endl;
+        }
+      }
+    }
+
+    if (inotifyFD >= 0) {
+      close(inotifyFD);
+    }
+  }
+
   int run(std::string configuration) {
     //
     // Now, launch the actual processing
     //
     try {
-      // Just to show some basic process info to user
+      // Just to show some basic process info to user. Otherwise the metadata is collected while the sources
+      // read their JWE, and only waited for by the first Tang request
       meta::composition           metaData;
-      metaData.printInfo();
+      if (logger::ISINFO == true) {
+        metaData.printInfo();
+      }
 
       INFO() << "Starting overall processing of the given configuration" << std::endl;
-      if (configuration.empty() == false) { 
+      if (configurationFile.empty() == false) {
+        DEBUG() << "The configuration file is " << configurationFile.string() << std::endl;
+        configuration::secretCfgList_t  declarations = configuration::parseFileToMsg(configurationFile, configurationCache);
+        startup::mark("configuration parsed");
+        assets::list    assets(declarations, compatibleMode, dumpHeader);    // This also starts all the providers.
+        startup::mark("assets started");
+        DEBUG() << "The assets were created and we should be fully running" << std::endl;
+        if (dumpHeader == false) {
+          superviseConfiguration(assets);
+        }
+      } else if (configuration.empty() == false) { 
         DEBUG() << "The configuration string is " << configuration << std::endl;  
-        assets::list    assets(configuration::parseStringToMsg(configuration), compatibleMode, dumpHeader);    // This also starts all the providers.
+        configuration::secretCfgList_t  declarations = (implicitInput == true) ? configuration::implicitList() : configuration::parseStringToMsg(configuration);
+        startup::mark("configuration parsed");
+        assets::list    assets(declarations, compatibleMode, dumpHeader);    // This also starts all the providers.
+        startup::mark("assets started");
         DEBUG() << "The assets were created and we should be fully running" << std::endl;
       } else {
         USERMSG() << "Missing configuration" << std::endl;
@@ -221,6 +382,37 @@ namespace latchy {
     return 0;
   }
 
+  int runAgent(const std::string& socketPath) {
+    //
+    // Resident mode. Requests arrive over the socket until we are told to stop (SIGTERM / SIGINT)
+    //
+    try {
+      agent::server               server(socketPath, compatibleMode);
+      server.run();
+    } catch(std::exception& exc) {
+      USERMSG() << "Unexpected exception in the agent - " << exc.what() << std::endl;
+      return -1;
+    }
+
+    return 0;
+  }
+
+  int runBatch() {
+    //
+    // Bulk mode. Records on stdin, results on stdout, logs on stderr
+    //
+    try {
+      logger::USESTDERR = true;
+
+      batch::processor            processor(batchWindow, compatibleMode);
+      std::size_t                 failures = processor.run(std::cin, std::cout);
+      return (failures == 0) ? 0 : 1;
+    } catch(std::exception& exc) {
+      USERMSG() << "Unexpected exception in batch mode - " << exc.what() << std::endl;
+      return -1;
+    }
+  }
+
   //
   // Real process main.
   //
@@ -263,9 +455,21 @@ namespace latchy {
         implicit = true;
       }
 
-      // Process the stdin. May be a configuration or a JWE
-      if (inputConfiguration.empty() == true) {
+      if (std::getenv("LATCHY_STARTUP_TIMING") != nullptr) {
+        startup::enable();
+      }
+      startup::mark("command line");
+
+      // libcurl, OpenSSL and the process metadata are only needed by the first Tang request. Get them ready in
+      // the background while we wait for stdin and build the assets
+      curlWrapper::prepare();
+      meta::composition::prefetch();
+
+      // Process the stdin. May be a configuration or a JWE. The agent gets everything from its socket instead and
+      // the batch mode reads its records itself
+      if ( (inputConfiguration.empty() == true) and (configurationFile.empty() == true) and (agentSocket.empty() == true) and (batchMode == false) ) {
         inputConfiguration = captureStdIn();
+        startup::mark("input");
       }     
 
     } catch(std::exception& exc) {
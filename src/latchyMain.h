@@ -16,11 +16,19 @@
 #pragma once
 
 #include <string>
+#include <chrono>
+#include <filesystem>
 namespace latchy {
   extern std::string      inputConfiguration;
+  extern std::string      agentSocket;
+  extern bool             batchMode;
+  extern std::filesystem::path   metricsFile;         // Empty when not exporting
+  extern std::chrono::seconds    metricsInterval;
 
   int                     main(int argc, char** argv);
   int                     run(std::string configuration);
+  int                     runAgent(const std::string& socketPath);
+  int                     runBatch();
 } // namespace latchy
 
 
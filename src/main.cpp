@@ -15,12 +15,24 @@
  */
 #include "latchyMain.h"
 #include "helpers/log.h"
+#include "helpers/metrics.h"
+#include "helpers/startup.h"
 
 int main(int argc, char** argv) {
   // This simply jumps to the real main in the given namespace
+  startup::mark("main");
   try {
     latchy::main(argc, argv);
-    int       returncode = latchy::run(latchy::inputConfiguration);
+    metrics::exporter   exporter(latchy::metricsFile, latchy::metricsInterval);   // Exports once more on the way out
+    int       returncode = 0;
+    if (latchy::agentSocket.empty() == false) {
+      returncode = latchy::runAgent(latchy::agentSocket);
+    } else if (latchy::batchMode == true) {
+      returncode = latchy::runBatch();
+    } else {
+      returncode = latchy::run(latchy::inputConfiguration);
+    }
+    startup::report();      // When no Tang request was made
     INFO() << "Return code (which we use as the exit code) from run " << returncode << std::endl;
     return returncode;
   }
@@ -27,10 +27,10 @@ namespace container {
   }
 
   void info::populateGeneric() {
-    try {
-      const std::string               id = helpers::fileAccess::readAll("/etc/hostname");
+    std::string                       id;
+    if (!helpers::fileAccess::readFile("/etc/hostname", id)) {
       data << id;
-    } catch (...) {}
+    }
   }
 
   void info::populateDocker() {
@@ -44,10 +44,10 @@ namespace container {
       data << ((data.str().empty()) ? "" : itemSeparator) << cgroup_ns;
     } else {
       // Lets try the non cgroup namespace mode, ie when info under /proc/self/cgroup is present
-      try {
-        const std::string             cgroup_info = helpers::fileAccess::readAll("/proc/self/cgroup");
+      std::string                     cgroup_info;
+      if (!helpers::fileAccess::readFile("/proc/self/cgroup", cgroup_info)) {
         data << ((data.str().empty()) ? "" : itemSeparator) << cgroup_info;
-      } catch (...) {}
+      }
     }
   }
 
@@ -22,15 +22,11 @@ namespace meta {
 namespace machine {
 
   info::info() {
-    try {
-      data = helpers::fileAccess::readAll("/etc/machine-id");
-    } catch (...) {}
+    helpers::fileAccess::readFile("/etc/machine-id", data);    // Left empty when unavailable
   }
 
   hostname::hostname() {
-    try {
-      data = helpers::fileAccess::readAll("/etc/hostname");;
-    } catch (...) {}
+    helpers::fileAccess::readFile("/etc/hostname", data);
   }
 } // namespace machine
 } // namespace meta
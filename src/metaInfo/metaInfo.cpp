@@ -17,6 +17,7 @@
 #include "metaInfo.h"
 #include "machineInfo.h"
 #include "processInfo.h"
+#include "helpers/startup.h"
 
 #include <botan/hash.h>
 #include <botan/hex.h>
@@ -25,61 +26,68 @@
 
 namespace meta {
 
-composition::composition() {
-  sources.emplace_back(std::make_unique<meta::machine::info>());
-  sources.emplace_back(std::make_unique<meta::machine::hostname>());
-  sources.emplace_back(std::make_unique<meta::process::info>());
-  sources.emplace_back(std::make_unique<meta::container::info>());
+composition::composition(): collected(collect()) {
+}
 
-  // Gather the persistent data
-  for (const auto& item : sources) {
-    if (item->isPersistent()) {
-      persistentData << ((persistentData.str().empty()) ? "" : itemSeparator) << item->rawData();
-    }
+void composition::prefetch() {
+  collect();
+}
+
+composition::snapshot_f composition::collect() {
+  static snapshot_f                       process = std::async(std::launch::async, &composition::build).share();
+  return process;
+}
+
+std::shared_ptr<const composition::snapshot_t> composition::build() {
+  const std::string                       itemSeparator = "~~";
+  std::shared_ptr<snapshot_t>             retval = std::make_shared<snapshot_t>();
+
+  // Each source reads its own files, let them do so at the same time
+  std::vector<std::future<info_p>>        pending;
+  pending.push_back(std::async(std::launch::async, []() -> info_p { return std::make_unique<meta::machine::info>(); }));
+  pending.push_back(std::async(std::launch::async, []() -> info_p { return std::make_unique<meta::machine::hostname>(); }));
+  pending.push_back(std::async(std::launch::async, []() -> info_p { return std::make_unique<meta::process::info>(); }));
+  pending.push_back(std::async(std::launch::async, []() -> info_p { return std::make_unique<meta::container::info>(); }));
+  for (auto& source : pending) {
+    retval->sources.push_back(source.get());
   }
 
-  // Gather the semi-persistent data
-  for (const auto& item : sources) {
+  // Gather the data, by category, in the order of the sources
+  for (const auto& item : retval->sources) {
+    const std::string                     raw = item->rawData();
+    if (item->isPersistent()) {
+      retval->persistentData += ((retval->persistentData.empty()) ? "" : itemSeparator) + raw;
+    }
     if (item->isSemiPersistent()) {
-      semiPersistentData << ((semiPersistentData.str().empty()) ? "" :itemSeparator) << item->rawData();
+      retval->semiPersistentData += ((retval->semiPersistentData.empty()) ? "" : itemSeparator) + raw;
     }
-  }
-
-  // Gather the semi-volatile data
-  for (const auto& item : sources) {
     if (item->isSemiVolatile()) {
-      semiVolatileData << ((semiVolatileData.str().empty()) ? "" : itemSeparator) << item->rawData();
+      retval->semiVolatileData += ((retval->semiVolatileData.empty()) ? "" : itemSeparator) + raw;
     }
-  }
-
-  // Gather the volatile data
-  for (const auto& item : sources) {
     if (item->isVolatile()) {
-      volatileData << ((volatileData.str().empty()) ? "" : itemSeparator) << item->rawData();
+      retval->volatileData += ((retval->volatileData.empty()) ? "" : itemSeparator) + raw;
     }
   }
-}
-
-const std::string composition::getComposedHash() const {
-  std::stringstream                       retval;
 
-  retval << ((retval.str().empty()) ? "" : itemSeparator) << getPersistentHash();
-  retval << ((retval.str().empty()) ? "" : itemSeparator) << getSemiPersistentHash();
-  retval << ((retval.str().empty()) ? "" : itemSeparator) << getSemiVolatileHash();
-  retval << ((retval.str().empty()) ? "" : itemSeparator) << getVolatileHash();
+  retval->persistentHash = getHash(retval->persistentData);
+  retval->semiPersistentHash = getHash(retval->semiPersistentData);
+  retval->semiVolatileHash = getHash(retval->semiVolatileData);
+  retval->volatileHash = getHash(retval->volatileData);
+  retval->composedHash = retval->persistentHash + itemSeparator + retval->semiPersistentHash + itemSeparator + retval->semiVolatileHash + itemSeparator + retval->volatileHash;
 
-  return retval.str();
+  startup::mark("process metadata ready");
+  return retval;
 }
 
 void composition::printInfo() const {
-  for (const auto& source : sources) {
+  for (const auto& source : snapshot().sources) {
     source->printInfo();
   }
 }
 
-const std::string composition::getHash(const std::stringstream& data) const {
+const std::string composition::getHash(const std::string& data) {
   std::unique_ptr<Botan::HashFunction>    hash = Botan::HashFunction::create_or_throw("SHA-512");
-  hash->update(data.str());
+  hash->update(data);
 
   return Botan::hex_encode(hash->final());
 }
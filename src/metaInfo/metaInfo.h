@@ -46,6 +46,7 @@
 #include <sstream>
 #include <vector>
 #include <memory>
+#include <future>
 
 #include "helpers/log.h"
 namespace meta {
@@ -72,6 +73,10 @@ namespace meta {
   ///
   /// Composition - Aggregate multiple source of data.
   ///
+  /// The data is static for the life of the process, so there is a single snapshot per process. It is
+  /// collected in the background (each source in parallel) the first time a composition is built, and the
+  /// hashes are computed once. Building a composition is cheap; the getters wait for the snapshot.
+  ///
   class composition {
   public:
     using info_p =                std::unique_ptr<info>;
@@ -79,33 +84,43 @@ namespace meta {
   public:
     composition();
 
-    const std::string             getComposedHash() const;
+    const std::string             getComposedHash() const { return snapshot().composedHash; };
 
-    const std::string             getPersistentHash() const { return getHash(persistentData); };
-    const std::string             getSemiPersistentHash() const { return getHash(semiPersistentData); };
-    const std::string             getSemiVolatileHash() const { return getHash(semiVolatileData); };
-    const std::string             getVolatileHash() const { return getHash(volatileData); };
+    const std::string             getPersistentHash() const { return snapshot().persistentHash; };
+    const std::string             getSemiPersistentHash() const { return snapshot().semiPersistentHash; };
+    const std::string             getSemiVolatileHash() const { return snapshot().semiVolatileHash; };
+    const std::string             getVolatileHash() const { return snapshot().volatileHash; };
 
-    const std::string             persistentDigest() const { return persistentData.str(); };
-    const std::string             semiPersistentDigest() const { return semiPersistentData.str(); };
-    const std::string             semiVolatileDigest() const { return semiVolatileData.str(); };
-    const std::string             volatileDigest() const { return volatileData.str(); };
+    const std::string             persistentDigest() const { return snapshot().persistentData; };
+    const std::string             semiPersistentDigest() const { return snapshot().semiPersistentData; };
+    const std::string             semiVolatileDigest() const { return snapshot().semiVolatileData; };
+    const std::string             volatileDigest() const { return snapshot().volatileData; };
 
     void                          printInfo() const;
+    static void                   prefetch();     // Starts collecting the snapshot, without waiting for it
   private:
-    sourceList_t                  sources;
-    const std::string             itemSeparator = "~~";
-
-
-    std::stringstream             persistentData;
-    std::stringstream             semiPersistentData;    
-    std::stringstream             semiVolatileData;
-    std::stringstream             volatileData;
-
-    std::stringstream             data;
-
-    const std::string             getHash(const std::stringstream&) const;
-
+    struct snapshot_t {
+      sourceList_t                sources;
+
+      std::string                 persistentData;
+      std::string                 semiPersistentData;
+      std::string                 semiVolatileData;
+      std::string                 volatileData;
+
+      std::string                 persistentHash;
+      std::string                 semiPersistentHash;
+      std::string                 semiVolatileHash;
+      std::string                 volatileHash;
+      std::string                 composedHash;
+    };
+    using snapshot_f =            std::shared_future<std::shared_ptr<const snapshot_t>>;
+
+    snapshot_f                    collected;
+
+    const snapshot_t&             snapshot() const { return *collected.get(); };
+    static snapshot_f             collect();      // Process wide, started once
+    static std::shared_ptr<const snapshot_t>    build();
+    static const std::string      getHash(const std::string&);
   };
 
 } // namespace meta
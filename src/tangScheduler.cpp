@@ -0,0 +1,118 @@
+/*
+ * Copyright 2024 NearEDGE, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "tangScheduler.h"
+#include "helpers/log.h"
+
+#include <map>
+#include <set>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+
+namespace tangScheduler {
+  using namespace std::chrono_literals;
+
+  namespace {
+    struct server {
+      std::uint32_t                     inFlight = 0;
+      std::set<std::pair<std::int64_t, std::uint64_t>>   waiting;   // (-priority, ticket), the next one first
+    };
+
+    struct state {
+      std::mutex                        access;
+      std::condition_variable           changed;
+      std::uint32_t                     defaultLimit = 0;       // 0 is no limit
+      std::map<std::string, std::uint32_t>   limits;
+      std::map<std::string, server>     servers;
+      std::uint64_t                     nextTicket = 0;
+    };
+
+    // Never destroyed, requests may still be in flight when static objects go
+    state& instance() {
+      static state*                     s = new state;
+      return *s;
+    }
+
+    // The same server, with or without a trailing slash
+    std::string normalized(const std::string& url) {
+      std::string                       retval(url);
+      while ( (retval.empty() == false) and (retval.back() == '/') ) {
+        retval.pop_back();
+      }
+      return retval;
+    }
+
+    std::uint32_t limitOf(const state& s, const std::string& url) {
+      auto                              found = s.limits.find(url);
+      return (found != s.limits.end()) ? found->second : s.defaultLimit;
+    }
+  }
+
+  void configure(const configuration::secretCfgList_t& list) {
+    state&                              s = instance();
+    {
+      std::lock_guard<std::mutex>       lock(s.access);
+      s.defaultLimit = list.maxinflight();
+      s.limits.clear();
+      for (const auto& tang : list.tang()) {
+        if (tang.maxinflight() == 0) {
+          continue;     // Not set, the global maxInFlight applies
+        }
+        s.limits[normalized(tang.url())] = tang.maxinflight();
+        INFO() << "Tang " << tang.url() << " limited to " << tang.maxinflight() << " requests in flight" << std::endl;
+      }
+    }
+    s.changed.notify_all();
+  }
+
+  slot::slot(const std::string& url, std::uint32_t priority, const std::atomic_bool& cancelled): server(normalized(url)) {
+    state&                              s = instance();
+    std::unique_lock<std::mutex>        lock(s.access);
+    auto&                               target = s.servers[server];
+    auto                                ticket = target.waiting.emplace(-static_cast<std::int64_t>(priority), s.nextTicket++).first;
+
+    bool                                queued = false;
+    while (cancelled == false) {
+      const std::uint32_t               limit = limitOf(s, server);
+      if ( ( (limit == 0) or (target.inFlight < limit) ) and (target.waiting.begin() == ticket) ) {
+        granted = true;
+        ++target.inFlight;
+        break;
+      }
+      if (queued == false) {
+        DEBUG() << "Tang " << server << " is saturated (" << target.inFlight << " in flight), queued with priority " << priority << std::endl;
+        queued = true;
+      }
+      s.changed.wait_for(lock, 250ms);    // Also to notice the cancellation
+    }
+    target.waiting.erase(ticket);
+
+    // The next in line may fit as well
+    lock.unlock();
+    s.changed.notify_all();
+  }
+
+  slot::~slot() {
+    if (granted == true) {
+      state&                            s = instance();
+      {
+        std::lock_guard<std::mutex>     lock(s.access);
+        --s.servers[server].inFlight;
+      }
+      s.changed.notify_all();
+    }
+  }
+} // namespace tangScheduler
@@ -0,0 +1,48 @@
+/*
+ * Copyright 2024 NearEDGE, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <string>
+#include <atomic>
+#include <cstdint>
+
+#include "configuration.h"
+
+/// Admission to the Tang servers
+///
+/// A Tang server may be given a maximum number of requests in flight (maxInFlight, per URL, or for all the
+/// servers of a configuration). Requests beyond it queue, the highest priority first and then in arrival order,
+/// so that boot critical secrets do not wait behind bulk ones. Servers without a limit admit right away.
+///
+///   {"maxInFlight": 8, "tang": [{"url": "http://tang.example", "maxInFlight": 2}], "secrets": [...]}
+namespace tangScheduler {
+  void                                  configure(const configuration::secretCfgList_t& list);   // Replaces the limits, the queued requests are reconsidered
+
+  /// One request to a Tang server, from construction to destruction. The constructor blocks until the server
+  /// admits it, or until cancelled.
+  class slot {
+  public:
+    slot(const std::string& url, std::uint32_t priority, const std::atomic_bool& cancelled);
+    slot(const slot&) = delete;
+    ~slot();
+
+    bool                                admitted() const { return granted; };
+
+  private:
+    std::string                         server;
+    bool                                granted = false;
+  };
+} // namespace tangScheduler
@@ -0,0 +1,766 @@
+/*
+ * Copyright 2024 NearEDGE, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <future>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <functional>
+#include <filesystem>
+#include <stdexcept>
+#include <cstring>
+#include <csignal>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <jansson.h>
+
+#include "joseCommon.h"
+#include "helpers/forkExec.h"
+#include "helpers/fileAccess.h"
+
+//
+// latchy_load - synthetic load for latchy
+//
+// Runs latchy against a growing number of secrets, round after round (the count doubles from --from to --to).
+// Each round is a fresh latchy process given a generated configuration that mixes the inputs (STDIN, IFILE,
+// IPIPE) and the outputs (STDOUT, FILE, PIPE). The Tang server is played in process on the loopback, with an
+// optional delay per request, and a pool of simulated consumers opens and reads the outputs, each after a think
+// time. Every secret read is checked against what was sealed.
+//
+// Per round: secrets delivered, throughput, latency percentiles (from latchy's start to the consumer holding the
+// secret), and latchy's peak RSS, thread count, open descriptors and inotify instances.
+//
+// The JWE are made once with the jose and clevis command line tools, against the key of the stand-in.
+//
+namespace {
+  using clock_t =                       std::chrono::steady_clock;
+  using namespace std::chrono_literals;
+
+  struct settings {
+    std::string                         latchy = "latchy";
+    std::filesystem::path               workDirectory = "latchy-load";
+    std::size_t                         from = 16;
+    std::size_t                         to = 1024;
+    std::size_t                         consumers = 64;
+    std::size_t                         distinct = 8;        // Different JWE, reused round robin
+    std::size_t                         payloadSize = 64;
+    std::chrono::milliseconds           think = 0ms;
+    std::chrono::milliseconds           tangDelay = 0ms;
+    std::chrono::seconds                timeout = 60s;        // Per round
+    bool                                standardStreams = true;
+    std::filesystem::path               jsonReport;
+    std::vector<std::string>            latchyArgs;           // After --
+  };
+
+  enum class input { stdinput, file, pipe };
+  enum class output { stdoutput, file, pipe };
+
+  struct sealed {
+    std::string                         secret;
+    std::string                         jwe;
+  };
+
+  struct asset {
+    std::size_t                         index;
+    input                               in;
+    output                              out;
+    std::filesystem::path               inPath;
+    std::filesystem::path               outPath;
+    const sealed*                       content;
+  };
+
+  bool writeAll(int fd, const std::string& data) {
+    for (std::size_t written = 0; written < data.size(); ) {
+      ssize_t                           done = write(fd, data.data() + written, data.size() - written);
+      if ( (done == -1) and (errno != EINTR) ) {
+        return false;
+      }
+      written += (done > 0) ? done : 0;
+    }
+    return true;
+  }
+
+  //
+  // Tang, on 127.0.0.1, answering the key recovery requests with its exchange key. HTTP/1.1 with keep alive, a
+  // thread per connection.
+  //
+  class loopbackTang {
+  public:
+    loopbackTang(const std::filesystem::path& exchangeKey, std::chrono::milliseconds delay);
+    loopbackTang(const loopbackTang&) = delete;
+    ~loopbackTang();
+
+    std::string                         url() const { return "http://127.0.0.1:" + std::to_string(port); };
+    std::size_t                         served() const { return requests.load(); };
+
+  private:
+    void                                acceptLoop();
+    void                                serve(int connection);
+    std::string                         answer(const std::string& method, const std::string& path, const std::string& body, json_t* localKey);
+
+    json_t*                             key = nullptr;
+    int                                 listenFD = -1;
+    std::uint16_t                       port = 0;
+    std::chrono::milliseconds           delay;
+    std::atomic<bool>                   stopping = false;
+    std::atomic<std::size_t>            requests = 0;
+    std::mutex                          access;
+    std::vector<std::thread>            connections;
+    std::thread                         acceptor;
+  };
+
+  loopbackTang::loopbackTang(const std::filesystem::path& exchangeKey, std::chrono::milliseconds delay): delay(delay) {
+    key = json_load_file(exchangeKey.c_str(), 0, nullptr);
+    if (key == nullptr) {
+      throw std::runtime_error("Cannot load the Tang exchange key " + exchangeKey.string());
+    }
+
+    listenFD = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_in                         address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t                           length = sizeof(address);
+    if ( (listenFD == -1) or
+         (bind(listenFD, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == -1) or
+         (listen(listenFD, SOMAXCONN) == -1) or
+         (getsockname(listenFD, reinterpret_cast<sockaddr*>(&address), &length) == -1) ) {
+      throw std::runtime_error(std::string("Cannot listen on the loopback - ") + strerror(errno));
+    }
+    port = ntohs(address.sin_port);
+    acceptor = std::thread(&loopbackTang::acceptLoop, this);
+  }
+
+  loopbackTang::~loopbackTang() {
+    stopping = true;
+    acceptor.join();
+    for (auto& connection : connections) {
+      connection.join();
+    }
+    close(listenFD);
+    json_decref(key);
+  }
+
+  void loopbackTang::acceptLoop() {
+    while (stopping == false) {
+      pollfd                            event = { listenFD, POLLIN, 0 };
+      if (poll(&event, 1, 200) <= 0) {
+        continue;
+      }
+      int                               connection = accept4(listenFD, nullptr, nullptr, SOCK_CLOEXEC);
+      if (connection != -1) {
+        std::lock_guard<std::mutex>     lock(access);
+        connections.emplace_back(&loopbackTang::serve, this, connection);
+      }
+    }
+  }
+
+  void loopbackTang::serve(int connection) {
+    // jansson reference counts are not shared safely between threads, each connection works on its own copy
+    json_t*                             localKey = nullptr;
+    {
+      std::lock_guard<std::mutex>       lock(access);
+      localKey = json_deep_copy(key);
+    }
+
+    std::string                         pending;
+    char                                buffer[16384];
+    bool                                keepAlive = true;
+    while ( (stopping == false) and (keepAlive == true) ) {
+      pollfd                            event = { connection, POLLIN, 0 };
+      if (poll(&event, 1, 200) <= 0) {
+        continue;
+      }
+      ssize_t                           got = read(connection, buffer, sizeof(buffer));
+      if (got <= 0) {
+        break;
+      }
+      pending.append(buffer, got);
+
+      // As many complete requests as received
+      for (auto headerEnd = pending.find("\r\n\r\n"); headerEnd != std::string::npos; headerEnd = pending.find("\r\n\r\n")) {
+        std::string                     header = pending.substr(0, headerEnd);
+        std::string                     lowered(header);
+        std::transform(lowered.begin(), lowered.end(), lowered.begin(), [](unsigned char c) { return std::tolower(c); });
+
+        std::size_t                     contentLength = 0;
+        if (auto found = lowered.find("\r\ncontent-length:"); found != std::string::npos) {
+          contentLength = std::stoul(lowered.substr(found + 17));
+        }
+        if (pending.size() < headerEnd + 4 + contentLength) {
+          break;
+        }
+        keepAlive = (lowered.find("\r\nconnection: close") == std::string::npos);
+
+        std::istringstream              requestLine(header.substr(0, header.find("\r\n")));
+        std::string                     method;
+        std::string                     path;
+        requestLine >> method >> path;
+
+        const std::string               reply = answer(method, path, pending.substr(headerEnd + 4, contentLength), localKey);
+        pending.erase(0, headerEnd + 4 + contentLength);
+        if (writeAll(connection, reply) == false) {
+          keepAlive = false;
+          break;
+        }
+      }
+    }
+    json_decref(localKey);
+    close(connection);
+  }
+
+  std::string loopbackTang::answer(const std::string& method, const std::string& path, const std::string& body, json_t* localKey) {
+    std::string                         status = "404 Not Found";
+    std::string                         content;
+
+    if ( (method == "POST") and (path.rfind("/rec/", 0) == 0) ) {
+      ++requests;
+      status = "400 Bad Request";
+      json_t*                           request = json_loadb(body.data(), body.size(), 0, nullptr);
+      if (request != nullptr) {
+        try {
+          json_t*                       exchanged = joseLibWrapper::keyExchange(localKey, request);
+          char*                         dumped = json_dumps(exchanged, JSON_COMPACT);
+          if (dumped != nullptr) {
+            content = dumped;
+            status = "200 OK";
+            free(dumped);
+          }
+          json_decref(exchanged);
+        } catch (const std::exception& e) {
+          content.clear();
+        }
+        json_decref(request);
+      }
+      std::this_thread::sleep_for(delay);
+    }
+
+    return "HTTP/1.1 " + status + "\r\nContent-Type: application/jwk+json\r\nContent-Length: " + std::to_string(content.size()) + "\r\n\r\n" + content;
+  }
+
+  //
+  // Keys and JWE
+  //
+
+  void runShell(const std::string& script) {
+    os::launch::exec                    shell({ "/bin/sh", "-c", script }, false, false, true, true);
+    if (shell.exitCode() != 0) {
+      throw std::runtime_error("Failed: " + script + "\n" + shell.getError());
+    }
+  }
+
+  // The keys tangd would have, and its advertisement
+  void makeTangKeys(const std::filesystem::path& directory) {
+    std::filesystem::create_directories(directory);
+    const std::string                   d = directory.string();
+    runShell("jose jwk gen -i '{\"alg\":\"ES512\"}' -o '" + d + "/sig.jwk' && "
+             "jose jwk gen -i '{\"alg\":\"ECMR\"}' -o '" + d + "/exc.jwk' && "
+             "jose jwk pub -s -i '" + d + "/sig.jwk' -i '" + d + "/exc.jwk' | "
+             "jose jws sig -I- -s '{\"protected\":{\"cty\":\"jwk-set+json\"}}' -k '" + d + "/sig.jwk' -o '" + d + "/adv.jws'");
+  }
+
+  std::vector<sealed> sealSecrets(const settings& s, const std::filesystem::path& directory, const std::string& url) {
+    const std::string                   clevisCfg = R"({"url":")" + url + R"(","adv":")" + (directory / "adv.jws").string() + R"("})";
+    const std::string                   alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789";
+    std::uint32_t                       state = 0x9e3779b9;
+    std::vector<sealed>                 retval(s.distinct);
+
+    for (auto& item : retval) {
+      item.secret.resize(s.payloadSize);
+      for (auto& c : item.secret) {
+        state = state * 1664525 + 1013904223;
+        c = alphabet[(state >> 24) % alphabet.size()];
+      }
+      os::launch::exec                  clevis({ "clevis", "encrypt", "tang", clevisCfg }, false, true, true, true);
+      clevis.sendBuffer(item.secret, true);
+      if (clevis.exitCode() != 0) {
+        throw std::runtime_error("clevis encrypt failed - " + clevis.getError());
+      }
+      item.jwe = clevis.getOutput();
+      while ( (item.jwe.empty() == false) and (item.jwe.back() == '\n') ) {
+        item.jwe.pop_back();
+      }
+    }
+    return retval;
+  }
+
+  //
+  // Process sampling, from /proc
+  //
+
+  struct peaks {
+    std::size_t                         rssKiB = 0;
+    std::size_t                         threads = 0;
+    std::size_t                         descriptors = 0;
+    std::size_t                         inotify = 0;
+  };
+
+  void sample(pid_t pid, peaks& p) {
+    const std::filesystem::path         proc = "/proc/" + std::to_string(pid);
+    std::ifstream                       status(proc / "status");
+    std::string                         line;
+    while (std::getline(status, line)) {
+      if (line.rfind("VmHWM:", 0) == 0) {
+        p.rssKiB = std::max<std::size_t>(p.rssKiB, std::stoul(line.substr(6)));
+      } else if (line.rfind("Threads:", 0) == 0) {
+        p.threads = std::max<std::size_t>(p.threads, std::stoul(line.substr(8)));
+      }
+    }
+
+    std::error_code                     ec;
+    std::size_t                         descriptors = 0;
+    std::size_t                         inotify = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(proc / "fd", ec)) {
+      ++descriptors;
+      if (std::filesystem::read_symlink(entry.path(), ec).string() == "anon_inode:inotify") {
+        ++inotify;
+      }
+    }
+    p.descriptors = std::max(p.descriptors, descriptors);
+    p.inotify = std::max(p.inotify, inotify);
+  }
+
+  //
+  // The simulated clients
+  //
+
+  bool beforeDeadline(clock_t::time_point deadline) {
+    return clock_t::now() < deadline;
+  }
+
+  // Feeds an IPIPE input once latchy has the read side open
+  void writeInputPipe(const asset& a, clock_t::time_point deadline) {
+    int                                 fd = -1;
+    while ( (fd == -1) and (beforeDeadline(deadline) == true) ) {
+      fd = open(a.inPath.c_str(), O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+      if (fd == -1) {
+        std::this_thread::sleep_for(1ms);
+      }
+    }
+    if (fd != -1) {
+      fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+      writeAll(fd, a.content->jwe);
+      close(fd);
+    }
+  }
+
+  // Reads the whole secret from a PIPE output, false on timeout
+  bool readOutputPipe(const asset& a, std::string& received, clock_t::time_point deadline) {
+    int                                 fd = -1;
+    while ( (fd == -1) and (beforeDeadline(deadline) == true) ) {
+      fd = open(a.outPath.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);     // Fails until latchy creates the pipe
+      if (fd == -1) {
+        std::this_thread::sleep_for(2ms);
+      }
+    }
+    if (fd == -1) {
+      return false;
+    }
+
+    char                                buffer[16384];
+    while ( (received.size() < a.content->secret.size()) and (beforeDeadline(deadline) == true) ) {
+      pollfd                            event = { fd, POLLIN, 0 };
+      poll(&event, 1, 20);
+      ssize_t                           got = read(fd, buffer, sizeof(buffer));
+      if (got > 0) {
+        received.append(buffer, got);
+      } else if ( (got == 0) and (received.empty() == false) ) {
+        break;                          // The writer went away
+      } else {
+        std::this_thread::sleep_for(1ms);    // No writer yet
+      }
+    }
+    close(fd);
+    return received.size() >= a.content->secret.size();
+  }
+
+  // Reads a FILE output once it is complete, false on timeout
+  bool readOutputFile(const asset& a, std::string& received, clock_t::time_point deadline) {
+    while (beforeDeadline(deadline) == true) {
+      struct stat                       info;
+      if ( (stat(a.outPath.c_str(), &info) == 0) and (static_cast<std::size_t>(info.st_size) >= a.content->secret.size()) ) {
+        return (helpers::fileAccess::readFile(a.outPath, received, true) == std::error_code());
+      }
+      std::this_thread::sleep_for(2ms);
+    }
+    return false;
+  }
+
+  //
+  // One round
+  //
+
+  struct roundResult {
+    std::size_t                         secrets = 0;
+    std::size_t                         delivered = 0;
+    std::size_t                         wrong = 0;          // Content differs from what was sealed
+    std::size_t                         timedOut = 0;
+    double                              wallSeconds = 0;
+    std::vector<double>                 latencies;          // ms, sorted
+    peaks                               process;
+    std::size_t                         tangRequests = 0;
+    int                                 exitStatus = 0;
+
+    double percentile(double p) const {
+      if (latencies.empty() == true) {
+        return 0;
+      }
+      return latencies[std::min(latencies.size() - 1, static_cast<std::size_t>(p * latencies.size()))];
+    }
+  };
+
+  std::vector<asset> layout(const settings& s, const std::vector<sealed>& pool, const std::filesystem::path& directory, std::size_t count) {
+    std::vector<asset>                  retval;
+    for (std::size_t i = 0; i < count; ++i) {
+      asset                             a;
+      a.index = i;
+      a.content = &pool[i % pool.size()];
+      // Every input kind meets every output kind
+      a.in = ( (s.standardStreams == true) and (i == 0) ) ? input::stdinput : ((i % 2 == 0) ? input::file : input::pipe);
+      a.out = ( (s.standardStreams == true) and (i == 1) ) ? output::stdoutput : (((i / 2) % 2 == 0) ? output::file : output::pipe);
+      a.inPath = directory / "in" / (std::to_string(i) + ".jwe");
+      a.outPath = directory / "out" / std::to_string(i);
+      retval.push_back(a);
+    }
+    return retval;
+  }
+
+  std::string configuration(const std::vector<asset>& assets) {
+    std::string                         retval(R"({"secrets":[)");
+    for (const auto& a : assets) {
+      retval += (a.index == 0) ? "\n" : ",\n";
+      switch (a.in) {
+        case input::stdinput: retval += R"({"iMethod":"STDIN")"; break;
+        case input::file:     retval += R"({"iMethod":"IFILE","in":")" + a.inPath.string() + "\""; break;
+        case input::pipe:     retval += R"({"iMethod":"IPIPE","in":")" + a.inPath.string() + "\""; break;
+      }
+      retval += R"(,"lockingMethod":"CLEVIS",)";
+      switch (a.out) {
+        case output::stdoutput: retval += R"("eMethod":"STDOUT"})"; break;
+        case output::file:      retval += R"("eMethod":"FILE","out":")" + a.outPath.string() + R"(","outCount":1})"; break;
+        case output::pipe:      retval += R"("eMethod":"PIPE","out":")" + a.outPath.string() + R"(","outCount":1})"; break;
+      }
+    }
+    return retval + "\n]}\n";
+  }
+
+  roundResult runRound(const settings& s, const std::vector<sealed>& pool, const loopbackTang& tang, std::size_t count) {
+    const std::filesystem::path         directory = s.workDirectory / ("round-" + std::to_string(count));
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory / "in");
+    std::filesystem::create_directories(directory / "out");
+
+    const std::vector<asset>            assets = layout(s, pool, directory, count);
+    const asset*                        fromStdin = nullptr;
+    const asset*                        toStdout = nullptr;
+    for (const auto& a : assets) {
+      if (a.in == input::file) {
+        helpers::fileAccess::writeTo(a.inPath, a.content->jwe, false);
+      } else if (a.in == input::pipe) {
+        mkfifo(a.inPath.c_str(), 0600);
+      } else {
+        fromStdin = &a;
+      }
+      toStdout = (a.out == output::stdoutput) ? &a : toStdout;
+    }
+    helpers::fileAccess::writeTo(directory / "latchy.json", configuration(assets), false);
+
+    roundResult                         result;
+    result.secrets = count;
+    const std::size_t                   tangBefore = tang.served();
+
+    // latchy, its stderr in the round directory
+    int                                 stdinPipe[2];
+    int                                 stdoutPipe[2];
+    if ( (pipe2(stdinPipe, O_CLOEXEC) == -1) or (pipe2(stdoutPipe, O_CLOEXEC) == -1) ) {
+      throw std::runtime_error(std::string("Cannot create pipes - ") + strerror(errno));
+    }
+    int                                 errFD = open((directory / "latchy.log").c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    os::launch::cmdArgList_t            args = { "--cfg-file", (directory / "latchy.json").string() };
+    args.insert(args.end(), s.latchyArgs.begin(), s.latchyArgs.end());
+
+    const auto                          start = clock_t::now();
+    const auto                          deadline = start + s.timeout;
+    const pid_t                         pid = os::launch::launch(s.latchy, args, "", stdinPipe[0], stdoutPipe[1], errFD);
+
+    std::mutex                          resultAccess;
+    auto                                done = [&](const asset& a, bool complete, const std::string& received) {
+      std::lock_guard<std::mutex>       lock(resultAccess);
+      if (complete == false) {
+        ++result.timedOut;
+      } else if (received != a.content->secret) {
+        ++result.wrong;
+      } else {
+        ++result.delivered;
+        result.latencies.push_back(std::chrono::duration<double, std::milli>(clock_t::now() - start).count());
+      }
+    };
+
+    std::atomic<bool>                   sampling = true;
+    std::thread                         sampler([&]() {
+      while (sampling == true) {
+        sample(pid, result.process);
+        std::this_thread::sleep_for(100ms);
+      }
+    });
+
+    // STDIN, then STDOUT
+    auto                                feeder = std::async(std::launch::async, [&]() {
+      if (fromStdin != nullptr) {
+        writeAll(stdinPipe[1], fromStdin->content->jwe);
+      }
+      close(stdinPipe[1]);
+    });
+    auto                                stdoutReader = std::async(std::launch::async, [&]() {
+      std::string                       received;
+      char                              buffer[16384];
+      while ( (toStdout != nullptr) and (received.size() < toStdout->content->secret.size()) and (beforeDeadline(deadline) == true) ) {
+        pollfd                          event = { stdoutPipe[0], POLLIN, 0 };
+        if (poll(&event, 1, 100) <= 0) {
+          continue;
+        }
+        ssize_t                         got = read(stdoutPipe[0], buffer, sizeof(buffer));
+        if (got <= 0) {
+          break;
+        }
+        received.append(buffer, got);
+      }
+      if (toStdout != nullptr) {
+        done(*toStdout, received.size() >= toStdout->content->secret.size(), received);
+      }
+    });
+
+    // The named pipe writers first, then the consumers, on a pool of threads
+    std::vector<std::function<void()>>  tasks;
+    for (const auto& a : assets) {
+      if (a.in == input::pipe) {
+        tasks.push_back([&a, deadline]() { writeInputPipe(a, deadline); });
+      }
+    }
+    for (const auto& a : assets) {
+      if (a.out != output::stdoutput) {
+        tasks.push_back([&a, &s, &done, deadline]() {
+          std::this_thread::sleep_for(s.think);
+          std::string                   received;
+          bool                          complete = (a.out == output::pipe) ? readOutputPipe(a, received, deadline) : readOutputFile(a, received, deadline);
+          done(a, complete, received);
+        });
+      }
+    }
+    std::atomic<std::size_t>            next = 0;
+    std::vector<std::thread>            workers;
+    for (std::size_t i = 0; i < std::max<std::size_t>(1, s.consumers); ++i) {
+      workers.emplace_back([&]() {
+        for (std::size_t task = next++; task < tasks.size(); task = next++) {
+          tasks[task]();
+        }
+      });
+    }
+    for (auto& worker : workers) {
+      worker.join();
+    }
+    stdoutReader.get();
+    feeder.get();
+    if (result.latencies.empty() == false) {
+      result.wallSeconds = *std::max_element(result.latencies.begin(), result.latencies.end()) / 1000.0;
+    }
+
+    sampling = false;
+    sampler.join();
+    sample(pid, result.process);
+    result.tangRequests = tang.served() - tangBefore;
+
+    // latchy keeps serving (it watches its configuration), stop it. SIGKILL if it does not go within 5s.
+    kill(pid, SIGTERM);
+    struct rusage                       usage{};
+    int                                 status = 0;
+    const auto                          stopDeadline = clock_t::now() + 5s;
+    while (wait4(pid, &status, WNOHANG, &usage) == 0) {
+      if (beforeDeadline(stopDeadline) == false) {
+        kill(pid, SIGKILL);
+        wait4(pid, &status, 0, &usage);
+        break;
+      }
+      std::this_thread::sleep_for(10ms);
+    }
+    result.process.rssKiB = std::max<std::size_t>(result.process.rssKiB, usage.ru_maxrss);
+    result.exitStatus = status;
+    close(stdoutPipe[0]);
+
+    std::sort(result.latencies.begin(), result.latencies.end());
+    return result;
+  }
+
+  //
+  // Reporting
+  //
+
+  void printLimits() {
+    struct rlimit                       files;
+    getrlimit(RLIMIT_NOFILE, &files);
+    std::string                         inotifyInstances;
+    helpers::fileAccess::readFile("/proc/sys/fs/inotify/max_user_instances", inotifyInstances, true);
+    std::string                         inotifyWatches;
+    helpers::fileAccess::readFile("/proc/sys/fs/inotify/max_user_watches", inotifyWatches, true);
+    std::cout << "Limits: open files " << files.rlim_cur
+              << ", inotify instances " << inotifyInstances.substr(0, inotifyInstances.find('\n'))
+              << ", inotify watches " << inotifyWatches.substr(0, inotifyWatches.find('\n')) << std::endl;
+  }
+
+  void printHeader() {
+    std::cout << std::setw(8) << "secrets" << std::setw(10) << "delivered" << std::setw(7) << "wrong" << std::setw(9) << "timeout"
+              << std::setw(9) << "wall s" << std::setw(11) << "secrets/s" << std::setw(10) << "p50 ms" << std::setw(10) << "p90 ms"
+              << std::setw(10) << "p99 ms" << std::setw(10) << "max ms" << std::setw(10) << "RSS MiB" << std::setw(9) << "threads"
+              << std::setw(7) << "fds" << std::setw(9) << "inotify" << std::setw(7) << "tang" << std::endl;
+  }
+
+  void printRound(const roundResult& r) {
+    const double                        throughput = (r.wallSeconds > 0) ? r.delivered / r.wallSeconds : 0;
+    std::cout << std::fixed << std::setprecision(1)
+              << std::setw(8) << r.secrets << std::setw(10) << r.delivered << std::setw(7) << r.wrong << std::setw(9) << r.timedOut
+              << std::setw(9) << r.wallSeconds << std::setw(11) << throughput << std::setw(10) << r.percentile(0.50)
+              << std::setw(10) << r.percentile(0.90) << std::setw(10) << r.percentile(0.99) << std::setw(10) << r.percentile(1.0)
+              << std::setw(10) << r.process.rssKiB / 1024.0 << std::setw(9) << r.process.threads << std::setw(7) << r.process.descriptors
+              << std::setw(9) << r.process.inotify << std::setw(7) << r.tangRequests << std::endl;
+  }
+
+  std::string toJson(const settings& s, const std::vector<roundResult>& rounds) {
+    std::ostringstream                  out;
+    out << "{\"consumers\":" << s.consumers << ",\"thinkMs\":" << s.think.count() << ",\"tangDelayMs\":" << s.tangDelay.count()
+        << ",\"payloadSize\":" << s.payloadSize << ",\"rounds\":[";
+    for (std::size_t i = 0; i < rounds.size(); ++i) {
+      const roundResult&                r = rounds[i];
+      out << ((i == 0) ? "" : ",") << "{\"secrets\":" << r.secrets << ",\"delivered\":" << r.delivered << ",\"wrong\":" << r.wrong
+          << ",\"timedOut\":" << r.timedOut << ",\"wallSeconds\":" << r.wallSeconds
+          << ",\"throughput\":" << ((r.wallSeconds > 0) ? r.delivered / r.wallSeconds : 0)
+          << ",\"latencyMs\":{\"p50\":" << r.percentile(0.50) << ",\"p90\":" << r.percentile(0.90) << ",\"p99\":" << r.percentile(0.99)
+          << ",\"max\":" << r.percentile(1.0) << "},\"peakRssKiB\":" << r.process.rssKiB << ",\"peakThreads\":" << r.process.threads
+          << ",\"peakDescriptors\":" << r.process.descriptors << ",\"peakInotify\":" << r.process.inotify
+          << ",\"tangRequests\":" << r.tangRequests << ",\"exitStatus\":" << r.exitStatus << "}";
+    }
+    out << "]}\n";
+    return out.str();
+  }
+
+  void usage(const char* name) {
+    std::cout << "Usage: " << name << " [options] [-- latchy arguments]\n"
+              << "  --latchy PATH        latchy binary (latchy, from the PATH)\n"
+              << "  --workdir DIR        Keys, JWE, configurations and latchy logs (latchy-load)\n"
+              << "  --from N             Secrets in the first round (16)\n"
+              << "  --to N               Secrets in the last round, doubling each round (1024)\n"
+              << "  --consumers N        Simulated clients reading the outputs concurrently (64)\n"
+              << "  --think MS           Delay before a client opens its output (0)\n"
+              << "  --tang-delay MS      Delay added to every Tang answer (0)\n"
+              << "  --size BYTES         Secret size (64)\n"
+              << "  --distinct N         Different JWE, reused across the secrets (8)\n"
+              << "  --timeout S          Per round (60)\n"
+              << "  --no-stdio           No STDIN input nor STDOUT output\n"
+              << "  --json FILE          Also write the results as JSON\n";
+  }
+
+  settings parseArguments(int argc, char* argv[]) {
+    enum { OPTION_LATCHY = 1000, OPTION_WORKDIR, OPTION_FROM, OPTION_TO, OPTION_CONSUMERS, OPTION_THINK, OPTION_TANGDELAY,
+           OPTION_SIZE, OPTION_DISTINCT, OPTION_TIMEOUT, OPTION_NOSTDIO, OPTION_JSON };
+    const struct option                 longOptions[] = {
+      {"help", no_argument, nullptr, 'h'},
+      {"latchy", required_argument, nullptr, OPTION_LATCHY},
+      {"workdir", required_argument, nullptr, OPTION_WORKDIR},
+      {"from", required_argument, nullptr, OPTION_FROM},
+      {"to", required_argument, nullptr, OPTION_TO},
+      {"consumers", required_argument, nullptr, OPTION_CONSUMERS},
+      {"think", required_argument, nullptr, OPTION_THINK},
+      {"tang-delay", required_argument, nullptr, OPTION_TANGDELAY},
+      {"size", required_argument, nullptr, OPTION_SIZE},
+      {"distinct", required_argument, nullptr, OPTION_DISTINCT},
+      {"timeout", required_argument, nullptr, OPTION_TIMEOUT},
+      {"no-stdio", no_argument, nullptr, OPTION_NOSTDIO},
+      {"json", required_argument, nullptr, OPTION_JSON},
+      {nullptr, 0, nullptr, 0}
+    };
+
+    settings                            s;
+    int                                 option;
+    while ((option = getopt_long(argc, argv, "h", longOptions, nullptr)) != -1) {
+      switch (option) {
+        case OPTION_LATCHY:     s.latchy = optarg; break;
+        case OPTION_WORKDIR:    s.workDirectory = optarg; break;
+        case OPTION_FROM:       s.from = std::stoul(optarg); break;
+        case OPTION_TO:         s.to = std::stoul(optarg); break;
+        case OPTION_CONSUMERS:  s.consumers = std::stoul(optarg); break;
+        case OPTION_THINK:      s.think = std::chrono::milliseconds(std::stoul(optarg)); break;
+        case OPTION_TANGDELAY:  s.tangDelay = std::chrono::milliseconds(std::stoul(optarg)); break;
+        case OPTION_SIZE:       s.payloadSize = std::stoul(optarg); break;
+        case OPTION_DISTINCT:   s.distinct = std::max<std::size_t>(1, std::stoul(optarg)); break;
+        case OPTION_TIMEOUT:    s.timeout = std::chrono::seconds(std::stoul(optarg)); break;
+        case OPTION_NOSTDIO:    s.standardStreams = false; break;
+        case OPTION_JSON:       s.jsonReport = optarg; break;
+        default:
+          usage(argv[0]);
+          exit((option == 'h') ? 0 : 1);
+      }
+    }
+    s.latchyArgs.assign(argv + optind, argv + argc);
+    s.from = std::max<std::size_t>(1, s.from);
+    s.workDirectory = std::filesystem::absolute(s.workDirectory);
+    return s;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  signal(SIGPIPE, SIG_IGN);
+  const settings                        s = parseArguments(argc, argv);
+
+  try {
+    makeTangKeys(s.workDirectory / "tang");
+    loopbackTang                        tang(s.workDirectory / "tang" / "exc.jwk", s.tangDelay);
+    const std::vector<sealed>           pool = sealSecrets(s, s.workDirectory / "tang", tang.url());
+
+    printLimits();
+    std::cout << "Tang on " << tang.url() << ", " << s.consumers << " consumers, think " << s.think.count() << "ms, Tang delay "
+              << s.tangDelay.count() << "ms, " << s.payloadSize << " bytes secrets" << std::endl;
+    printHeader();
+
+    std::vector<roundResult>            rounds;
+    for (std::size_t count = s.from; count <= s.to; count *= 2) {
+      rounds.push_back(runRound(s, pool, tang, count));
+      printRound(rounds.back());
+    }
+
+    if (s.jsonReport.empty() == false) {
+      helpers::fileAccess::writeTo(s.jsonReport, toJson(s, rounds), false);
+    }
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}